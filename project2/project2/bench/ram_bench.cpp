@@ -0,0 +1,74 @@
+// Copyright 2024 Blaise Tine
+// 
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RAM page lookup micro-benchmark: reports lookups/s for each backend
+// on streaming and random access patterns.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <stdlib.h>
+#include <mem.h>
+
+using namespace tinyrv;
+
+#define PAGE_SIZE    4096
+#define WORKING_SET  (64 * 1024 * 1024)
+
+static double run(RAM::Backend backend, bool random, uint64_t count) {
+  RAM ram(PAGE_SIZE, 0, backend);
+
+  // populate the working set
+  for (uint64_t addr = 0; addr < WORKING_SET; addr += PAGE_SIZE) {
+    ram[addr] = 0;
+  }
+
+  uint32_t sum = 0;
+  uint64_t seed = 1;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t addr;
+    if (random) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      addr = (seed >> 33) & (WORKING_SET - 1);
+    } else {
+      addr = i & (WORKING_SET - 1);
+    }
+    sum += ram[addr];
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  // keep the loop alive
+  if (sum == 0xdeadbeef) {
+    std::cout << sum << std::endl;
+  }
+
+  std::chrono::duration<double> elapsed = end - start;
+  return count / elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  uint64_t count = (argc > 1) ? strtoull(argv[1], nullptr, 0) : 100000000;
+
+  const char* names[] = {"hashmap", "pagetable"};
+  RAM::Backend backends[] = {RAM::HashMap, RAM::PageTable};
+  for (int b = 0; b < 2; ++b) {
+    for (int random = 0; random < 2; ++random) {
+      auto rate = run(backends[b], random, count);
+      std::cout << std::left << std::setw(10) << names[b]
+                << std::setw(10) << (random ? "random" : "stream")
+                << std::fixed << std::setprecision(1) << (rate / 1e6) << " M lookups/s" << std::endl;
+    }
+  }
+  return 0;
+}
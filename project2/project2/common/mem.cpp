@@ -15,7 +15,14 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <elf.h>
 #include "util.h"
 
 using namespace tinyrv;
@@ -82,23 +89,98 @@ void RomMemDevice::write(const void* /*data*/, uint64_t /*addr*/, uint64_t /*siz
 
 ///////////////////////////////////////////////////////////////////////////////
 
-bool MemoryUnit::ADecoder::lookup(uint64_t addr, uint32_t wordSize, mem_accessor_t* ma) {
+bool MemoryUnit::ADecoder::lookup(uint64_t addr, uint32_t wordSize, mem_accessor_t* ma, bool spanning) {
   uint64_t end = addr + (wordSize - 1);
   assert(end >= addr);
-  for (auto iter = entries_.rbegin(), iterE = entries_.rend(); iter != iterE; ++iter) {
-    if (addr >= iter->start && end <= iter->end) {
+  if (index_dirty_) {
+    this->build_index();
+  }
+
+  // last-hit cache
+  if (last_hit_ < index_.size()) {
+    auto& interval = index_[last_hit_];
+    if (addr >= interval.start && end <= interval.end) {
+      ma->md   = interval.md;
+      ma->addr = addr - interval.base;
+      return true;
+    }
+  }
+
+  // find the last interval starting at or before addr
+  auto iter = std::upper_bound(index_.begin(), index_.end(), addr,
+    [](uint64_t a, const interval_t& interval) { return a < interval.start; });
+  if (iter != index_.begin()) {
+    --iter;
+    if (end <= iter->end) {
+      last_hit_ = iter - index_.begin();
       ma->md   = iter->md;
-      ma->addr = addr - iter->start;
+      ma->addr = addr - iter->base;
+      return true;
+    }
+  }
+
+  if (!spanning)
+    return false;
+
+  // an access spanning several intervals goes to the latest mapping holding all of it,
+  // e.g. an enclosing region across the edge of a device mapped inside it
+  for (auto it = entries_.rbegin(), itE = entries_.rend(); it != itE; ++it) {
+    if (addr >= it->start && end <= it->end) {
+      ma->md   = it->md;
+      ma->addr = addr - it->start;
       return true;
     }
   }
   return false;
 }
 
+void MemoryUnit::ADecoder::build_index() {
+  // later mappings shadow the overlapping parts of earlier ones
+  index_.clear();
+  for (auto& entry : entries_) {
+    std::vector<interval_t> index;
+    for (auto& interval : index_) {
+      if (interval.end < entry.start || interval.start > entry.end) {
+        index.push_back(interval);
+        continue;
+      }
+      if (interval.start < entry.start) {
+        index.push_back({interval.md, interval.start, entry.start - 1, interval.base});
+      }
+      if (interval.end > entry.end) {
+        index.push_back({interval.md, entry.end + 1, interval.end, interval.base});
+      }
+    }
+    index.push_back({entry.md, entry.start, entry.end, entry.start});
+    std::sort(index.begin(), index.end(),
+      [](const interval_t& a, const interval_t& b) { return a.start < b.start; });
+    index_.swap(index);
+  }
+  index_dirty_ = false;
+  last_hit_ = 0;
+}
+
 void MemoryUnit::ADecoder::map(uint64_t start, uint64_t end, MemDevice &md) {
   assert(end >= start);
   entry_t entry{&md, start, end};
   entries_.emplace_back(entry);
+  index_dirty_ = true;
+}
+
+void MemoryUnit::ADecoder::map(const std::vector<mem_mapping_t>& mappings) {
+  for (auto& mapping : mappings) {
+    assert(mapping.end >= mapping.start);
+    entries_.push_back({mapping.md, mapping.start, mapping.end});
+  }
+  index_dirty_ = true;
+}
+
+uint8_t* MemoryUnit::ADecoder::host_ptr(uint64_t addr, uint64_t size) {
+  // host pages must not hide a device mapped inside them
+  mem_accessor_t ma;
+  if (!this->lookup(addr, size, &ma, false))
+    return nullptr;
+  return ma.md->host_ptr(ma.addr, size);
 }
 
 void MemoryUnit::ADecoder::read(void* data, uint64_t addr, uint64_t size) {
@@ -122,16 +204,57 @@ void MemoryUnit::ADecoder::write(const void* data, uint64_t addr, uint64_t size)
 ///////////////////////////////////////////////////////////////////////////////
 
 MemoryUnit::MemoryUnit(uint64_t pageSize)
-  : pageSize_(pageSize)
+  : htlb_(HTLB_SIZE)
+  , pageSize_(pageSize)
   , enableVM_(pageSize != 0)
   , amo_reservation_({0x0, false}) {
   if (pageSize != 0) {
     tlb_[0] = TLBEntry(0, 077);
   }
+  this->htlbFlush();
 }
 
 void MemoryUnit::attach(MemDevice &m, uint64_t start, uint64_t end) {
   decoder_.map(start, end, m);
+  this->htlbFlush();
+}
+
+void MemoryUnit::attach(const std::vector<mem_mapping_t>& mappings) {
+  decoder_.map(mappings);
+  this->htlbFlush();
+}
+
+void MemoryUnit::htlbFlush() {
+  for (auto& entry : htlb_) {
+    entry.read_vpn  = ~uint64_t(0);
+    entry.write_vpn = ~uint64_t(0);
+    entry.host = nullptr;
+  }
+}
+
+uint8_t* MemoryUnit::htlbFill(uint64_t addr, bool write) {
+  uint64_t page_size = uint64_t(1) << HTLB_PAGE_BITS;
+  if (enableVM_ && pageSize_ < page_size)
+    return nullptr;
+  // translate with the regular permission checks
+  uint64_t vpage = addr & ~(page_size - 1);
+  uint64_t pAddr = this->toPhyAddr(vpage, write ? 16 : 1);
+  auto host = decoder_.host_ptr(pAddr, page_size);
+  if (host == nullptr)
+    return nullptr;
+  uint64_t vpn = addr >> HTLB_PAGE_BITS;
+  auto& entry = htlb_[vpn & (HTLB_SIZE - 1)];
+  if (entry.host != host) {
+    entry.read_vpn  = ~uint64_t(0);
+    entry.write_vpn = ~uint64_t(0);
+    entry.host = host;
+  }
+  if (write) {
+    entry.write_vpn = vpn;
+  } else {
+    entry.read_vpn = vpn;
+  }
+  return host;
 }
 
 MemoryUnit::TLBEntry MemoryUnit::tlbLookup(uint64_t vAddr, uint32_t flagMask) {
@@ -159,11 +282,34 @@ uint64_t MemoryUnit::toPhyAddr(uint64_t addr, uint32_t flagMask) {
 }
 
 void MemoryUnit::read(void* data, uint64_t addr, uint64_t size, bool sup) {
+  uint64_t offset = addr & ((uint64_t(1) << HTLB_PAGE_BITS) - 1);
+  if (!sup && (offset + size) <= (uint64_t(1) << HTLB_PAGE_BITS)) {
+    // fast path: cached host page
+    uint64_t vpn = addr >> HTLB_PAGE_BITS;
+    auto& entry = htlb_[vpn & (HTLB_SIZE - 1)];
+    auto host = (entry.read_vpn == vpn) ? entry.host : this->htlbFill(addr, false);
+    if (host) {
+      memcpy(data, host + offset, size);
+      return;
+    }
+  }
   uint64_t pAddr = this->toPhyAddr(addr, sup ? 8 : 1);
   return decoder_.read(data, pAddr, size);
 }
 
 void MemoryUnit::write(const void* data, uint64_t addr, uint64_t size, bool sup) {
+  uint64_t offset = addr & ((uint64_t(1) << HTLB_PAGE_BITS) - 1);
+  if (!sup && (offset + size) <= (uint64_t(1) << HTLB_PAGE_BITS)) {
+    // fast path: cached host page
+    uint64_t vpn = addr >> HTLB_PAGE_BITS;
+    auto& entry = htlb_[vpn & (HTLB_SIZE - 1)];
+    auto host = (entry.write_vpn == vpn) ? entry.host : this->htlbFill(addr, true);
+    if (host) {
+      memcpy(host + offset, data, size);
+      amo_reservation_.valid = false;
+      return;
+    }
+  }
   uint64_t pAddr = this->toPhyAddr(addr, sup ? 16 : 1);
   decoder_.write(data, pAddr, size);
   amo_reservation_.valid = false;
@@ -181,23 +327,33 @@ bool MemoryUnit::amo_check(uint64_t addr) {
 }
 void MemoryUnit::tlbAdd(uint64_t virt, uint64_t phys, uint32_t flags) {
   tlb_[virt / pageSize_] = TLBEntry(phys / pageSize_, flags);
+  this->htlbFlush();
 }
 
 void MemoryUnit::tlbRm(uint64_t va) {
   if (tlb_.find(va / pageSize_) != tlb_.end())
     tlb_.erase(tlb_.find(va / pageSize_));
+  this->htlbFlush();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-RAM::RAM(uint32_t page_size, uint64_t capacity) 
+RAM::RAM(uint32_t page_size, uint64_t capacity, Backend backend) 
   : capacity_(capacity)
   , page_bits_(log2ceil(page_size))
+  , backend_(backend)
+  , num_pages_(0)
   , last_page_(nullptr)
   , last_page_index_(0) {    
    assert(ispow2(page_size));
    assert(0 == capacity || ispow2(capacity));
    assert(0 == (capacity % page_size));
+   // split the 32-bit page index evenly between both levels
+   uint32_t index_bits = 32 - page_bits_;
+   l2_bits_ = index_bits / 2;
+   if (backend_ == PageTable) {
+     page_table_.resize(uint64_t(1) << (index_bits - l2_bits_), nullptr);
+   }
 }
 
 RAM::~RAM() {
@@ -205,13 +361,81 @@ RAM::~RAM() {
 }
 
 void RAM::clear() {
+  for (auto& table : page_table_) {
+    if (table == nullptr)
+      continue;
+    for (uint64_t i = 0, n = (uint64_t(1) << l2_bits_); i < n; ++i) {
+      this->free_page(table[i]);
+    }
+    delete[] table;
+    table = nullptr;
+  }
   for (auto& page : pages_) {
-    delete[] page.second;
+    this->free_page(page.second);
+  }
+  pages_.clear();
+  for (auto& mapping : mappings_) {
+    munmap(mapping.base, mapping.size);
   }
+  mappings_.clear();
+  zero_ranges_.clear();
+  num_pages_ = 0;
+  last_page_ = nullptr;
 }
 
 uint64_t RAM::size() const {
-  return uint64_t(pages_.size()) << page_bits_;
+  return num_pages_ << page_bits_;
+}
+
+uint8_t *RAM::alloc_page(uint64_t page_index) const {
+  uint32_t page_size = 1 << page_bits_;
+  uint8_t *ptr = new uint8_t[page_size];
+  // set uninitialized data to "baadf00d"
+  for (uint32_t i = 0; i < page_size; ++i) {
+    ptr[i] = (0xbaadf00d >> ((i & 0x3) * 8)) & 0xff;
+  }
+  // zero-initialized sections are filled on first touch
+  uint64_t page_start = page_index << page_bits_;
+  uint64_t page_end = page_start + page_size;
+  for (auto& range : zero_ranges_) {
+    uint64_t start = std::max(page_start, range.start);
+    uint64_t end = std::min(page_end, range.end);
+    if (start < end) {
+      memset(ptr + (start - page_start), 0, end - start);
+    }
+  }
+  ++num_pages_;
+  return ptr;
+}
+
+void RAM::free_page(uint8_t* page) const {
+  // mapped pages are released with their mapping
+  for (auto& mapping : mappings_) {
+    if (page >= mapping.base && page < (mapping.base + mapping.size))
+      return;
+  }
+  delete[] page;
+}
+
+uint8_t *&RAM::page_slot(uint64_t page_index) const {
+  uint64_t l1_index = page_index >> l2_bits_;
+  if (l1_index < page_table_.size()) {
+    auto& table = page_table_[l1_index];
+    if (table == nullptr) {
+      table = new uint8_t*[uint64_t(1) << l2_bits_]();
+    }
+    return table[page_index & ((uint64_t(1) << l2_bits_) - 1)];
+  }
+  // hashed fallback for addresses outside the radix table
+  return pages_[page_index];
+}
+
+uint8_t *RAM::lookup_page(uint64_t page_index) const {
+  auto& page = this->page_slot(page_index);
+  if (page == nullptr) {
+    page = this->alloc_page(page_index);
+  }
+  return page;
 }
 
 uint8_t *RAM::get(uint64_t address) const {
@@ -226,18 +450,7 @@ uint8_t *RAM::get(uint64_t address) const {
   if (last_page_ && last_page_index_ == page_index) {
     page = last_page_;
   } else {
-    auto it = pages_.find(page_index);
-    if (it != pages_.end()) {
-      page = it->second;
-    } else {
-      uint8_t *ptr = new uint8_t[page_size];
-      // set uninitialized data to "baadf00d"
-      for (uint32_t i = 0; i < page_size; ++i) {
-        ptr[i] = (0xbaadf00d >> ((i & 0x3) * 8)) & 0xff;
-      }
-      pages_.emplace(page_index, ptr);
-      page = ptr;
-    }
+    page = this->lookup_page(page_index);
     last_page_ = page;
     last_page_index_ = page_index;
   }
@@ -246,20 +459,111 @@ uint8_t *RAM::get(uint64_t address) const {
 }
 
 void RAM::read(void* data, uint64_t addr, uint64_t size) {
+  uint64_t page_size = uint64_t(1) << page_bits_;
   uint8_t* d = (uint8_t*)data;
-  for (uint64_t i = 0; i < size; i++) {
-    d[i] = *this->get(addr + i);
+  if (((addr & (page_size - 1)) + size) <= page_size) {
+    // fast path: the access fits in a single page
+    if (capacity_ != 0 && (addr + size) > capacity_) {
+      throw OutOfRange();
+    }
+    memcpy(d, this->get(addr), size);
+    return;
+  }
+  // split at page boundaries
+  while (size != 0) {
+    uint64_t chunk = std::min(size, page_size - (addr & (page_size - 1)));
+    this->read(d, addr, chunk);
+    d += chunk;
+    addr += chunk;
+    size -= chunk;
   }
 }
 
 void RAM::write(const void* data, uint64_t addr, uint64_t size) {
+  uint64_t page_size = uint64_t(1) << page_bits_;
   const uint8_t* d = (const uint8_t*)data;
-  for (uint64_t i = 0; i < size; i++) {
-    *this->get(addr + i) = d[i];
+  if (((addr & (page_size - 1)) + size) <= page_size) {
+    // fast path: the access fits in a single page
+    if (capacity_ != 0 && (addr + size) > capacity_) {
+      throw OutOfRange();
+    }
+    memcpy(this->get(addr), d, size);
+    return;
+  }
+  // split at page boundaries
+  while (size != 0) {
+    uint64_t chunk = std::min(size, page_size - (addr & (page_size - 1)));
+    this->write(d, addr, chunk);
+    d += chunk;
+    addr += chunk;
+    size -= chunk;
+  }
+}
+
+bool RAM::mapBinImage(const char* filename, uint64_t destination) {
+  uint64_t page_size = uint64_t(1) << page_bits_;
+  uint64_t sys_page_size = sysconf(_SC_PAGESIZE);
+  if ((page_size % sys_page_size) != 0
+   || (destination & (page_size - 1)) != 0)
+    return false;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // only whole pages are mapped, the tail is copied
+  uint64_t size = st.st_size;
+  uint64_t map_size = size & ~(page_size - 1);
+  if (capacity_ != 0 && (destination + size) > capacity_) {
+    close(fd);
+    throw OutOfRange();
+  }
+
+  this->clear();
+
+  if (map_size != 0) {
+    // private writable mapping: stores copy the touched page only
+    auto base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    mappings_.push_back({(uint8_t*)base, map_size});
+    for (uint64_t offset = 0; offset < map_size; offset += page_size) {
+      this->page_slot((destination + offset) >> page_bits_) = (uint8_t*)base + offset;
+      ++num_pages_;
+    }
+  }
+
+  if (size != map_size) {
+    auto tail = this->get(destination + map_size);
+    if (pread(fd, tail, size - map_size, map_size) != ssize_t(size - map_size)) {
+      std::cout << "error: cannot read " << filename << std::endl;
+      std::abort();
+    }
   }
+
+  close(fd);
+  return true;
 }
 
-void RAM::loadBinImage(const char* filename, uint64_t destination) {
+uint8_t* RAM::host_ptr(uint64_t addr, uint64_t size) {
+  uint64_t page_size = uint64_t(1) << page_bits_;
+  if (((addr & (page_size - 1)) + size) > page_size
+   || (capacity_ != 0 && (addr + size) > capacity_))
+    return nullptr;
+  return this->get(addr);
+}
+
+void RAM::loadBinImage(const char* filename, uint64_t destination, bool use_mmap) {
+  if (use_mmap && this->mapBinImage(filename, destination))
+    return;
+
   std::ifstream ifs(filename);
   if (!ifs) {
     std::cout << "error: " << filename << " not found" << std::endl;
@@ -267,79 +571,276 @@ void RAM::loadBinImage(const char* filename, uint64_t destination) {
   }
 
   ifs.seekg(0, ifs.end);
-  size_t size = ifs.tellg();
-  std::vector<uint8_t> content(size);
+  uint64_t size = ifs.tellg();
   ifs.seekg(0, ifs.beg);
-  ifs.read((char*)content.data(), size);
 
   this->clear();
-  this->write(content.data(), destination, size);
+
+  // copy the image straight into the destination pages
+  uint64_t page_size = uint64_t(1) << page_bits_;
+  uint64_t addr = destination;
+  while (size != 0) {
+    uint64_t chunk = std::min(size, page_size - (addr & (page_size - 1)));
+    if (capacity_ != 0 && (addr + chunk) > capacity_) {
+      throw OutOfRange();
+    }
+    ifs.read((char*)this->get(addr), chunk);
+    addr += chunk;
+    size -= chunk;
+  }
+}
+
+// hex digit values, 0xff for invalid characters
+static const uint8_t* hex_table() {
+  static uint8_t table[256];
+  static bool initialized = false;
+  if (!initialized) {
+    memset(table, 0xff, sizeof(table));
+    for (int i = 0; i < 10; ++i) {
+      table['0' + i] = i;
+    }
+    for (int i = 0; i < 6; ++i) {
+      table['A' + i] = 10 + i;
+      table['a' + i] = 10 + i;
+    }
+    initialized = true;
+  }
+  return table;
 }
 
 void RAM::loadHexImage(const char* filename) {
-  auto hti = [&](char c)->uint32_t {
-    if (c >= 'A' && c <= 'F')
-      return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f')
-      return c - 'a' + 10;
-    return c - '0';
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    std::cout << "error: " << filename << " not found" << std::endl;
+    std::abort();
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    std::cout << "error: cannot read " << filename << std::endl;
+    std::abort();
+  }
+  uint64_t size = st.st_size;
+  if (size == 0) {
+    std::cout << "error: empty image " << filename << std::endl;
+    std::abort();
+  }
+  auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cout << "error: cannot map " << filename << std::endl;
+    std::abort();
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+  auto content = (const char*)data;
+
+  this->clear();
+
+  auto table = hex_table();
+  const char* cur = content;
+  const char* end = content + size;
+  const char* line_pos = content;
+  uint32_t line_no = 1;
+
+  auto parse_error = [&](const char* msg) {
+    std::cout << "error: " << filename << ":" << std::dec << line_no << ": " << msg << std::endl;
+    std::abort();
   };
 
-  auto hToI = [&](const char *c, uint32_t size)->uint32_t {
-    uint32_t value = 0;
-    for (uint32_t i = 0; i < size; i++) {
-      value += hti(c[i]) << ((size - i - 1) * 4);
+  // decode a record into bytes: count, addr(2), type, data..., checksum
+  uint8_t record[5 + 255];
+  auto decode = [&](const char* src, uint32_t count) {
+    uint8_t bad = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      uint8_t hi = table[(uint8_t)src[2 * i]];
+      uint8_t lo = table[(uint8_t)src[2 * i + 1]];
+      bad |= (hi | lo);
+      record[i] = (hi << 4) | lo;
+    }
+    if (bad & 0xf0) {
+      parse_error("invalid hex digit");
     }
-    return value;
   };
 
-  std::ifstream ifs(filename);
-  if (!ifs) {
+  // contiguous data records are written to memory in batches,
+  // flushed when they reach the end of a page
+  std::vector<uint8_t> batch;
+  batch.reserve((uint64_t(1) << page_bits_) + 255);
+  uint32_t batch_addr = 0;
+  auto flush_batch = [&]() {
+    if (!batch.empty()) {
+      this->write(batch.data(), batch_addr, batch.size());
+      batch.clear();
+    }
+  };
+
+  uint32_t offset = 0;
+  bool done = false;
+  while (!done) {
+    cur = (const char*)memchr(cur, ':', end - cur);
+    if (cur == nullptr)
+      break;
+    line_no += std::count(line_pos, cur, '\n');
+    line_pos = cur;
+    ++cur;
+
+    if ((end - cur) < 10) {
+      parse_error("truncated record");
+    }
+    decode(cur, 1);
+    uint32_t byteCount = record[0];
+    uint32_t record_size = 5 + byteCount;
+    if (uint64_t(end - cur) < 2 * record_size) {
+      parse_error("truncated record");
+    }
+    decode(cur, record_size);
+    cur += 2 * record_size;
+
+    uint8_t checksum = 0;
+    for (uint32_t i = 0; i < record_size; ++i) {
+      checksum += record[i];
+    }
+    if (checksum != 0) {
+      parse_error("checksum mismatch");
+    }
+
+    const uint8_t* data = record + 4;
+    uint32_t key = record[3];
+    switch (key) {
+    case 0: {
+      uint32_t addr = ((record[1] << 8) | record[2]) + offset;
+      if (batch.empty() || addr != (batch_addr + batch.size())) {
+        flush_batch();
+        batch_addr = addr;
+      }
+      batch.insert(batch.end(), data, data + byteCount);
+      if (((batch_addr + batch.size()) >> page_bits_) != (batch_addr >> page_bits_)) {
+        flush_batch();
+      }
+    } break;
+    case 1:
+      done = true;
+      break;
+    case 2:
+      if (byteCount < 2) {
+        parse_error("invalid segment address record");
+      }
+      offset = ((data[0] << 8) | data[1]) << 4;
+      break;
+    case 4:
+      if (byteCount < 2) {
+        parse_error("invalid linear address record");
+      }
+      offset = ((data[0] << 8) | data[1]) << 16;
+      break;
+    default:
+      break;
+    }
+  }
+  flush_batch();
+
+  munmap((void*)content, size);
+}
+
+bool RAM::isElfImage(const char* filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  char magic[SELFMAG];
+  if (!ifs.read(magic, SELFMAG))
+    return false;
+  return (memcmp(magic, ELFMAG, SELFMAG) == 0);
+}
+
+void RAM::loadElfImage(const char* filename, uint64_t* entry, uint64_t* tohost) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     std::cout << "error: " << filename << " not found" << std::endl;
     std::abort();
   }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Elf32_Ehdr)) {
+    std::cout << "error: invalid ELF file " << filename << std::endl;
+    std::abort();
+  }
+  uint64_t size = st.st_size;
+  auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cout << "error: cannot map " << filename << std::endl;
+    std::abort();
+  }
+  auto content = (const uint8_t*)data;
+
+  auto ehdr = (const Elf32_Ehdr*)content;
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+   || ehdr->e_ident[EI_CLASS] != ELFCLASS32
+   || ehdr->e_ident[EI_DATA] != ELFDATA2LSB
+   || ehdr->e_machine != EM_RISCV
+   || ehdr->e_phentsize != sizeof(Elf32_Phdr)
+   || (ehdr->e_phoff + uint64_t(ehdr->e_phnum) * sizeof(Elf32_Phdr)) > size) {
+    std::cout << "error: " << filename << " is not a little-endian RV32 ELF executable" << std::endl;
+    std::abort();
+  }
 
-  ifs.seekg(0, ifs.end);
-  size_t size = ifs.tellg();
-  std::vector<char> content(size);
-  ifs.seekg(0, ifs.beg);
-  ifs.read(content.data(), size);
+  this->clear();
 
-  uint32_t offset = 0;
-  char *line = content.data();
+  auto phdrs = (const Elf32_Phdr*)(content + ehdr->e_phoff);
+  for (uint32_t i = 0; i < ehdr->e_phnum; ++i) {
+    auto& phdr = phdrs[i];
+    if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0)
+      continue;
+    if ((uint64_t(phdr.p_offset) + phdr.p_filesz) > size
+     || phdr.p_filesz > phdr.p_memsz) {
+      std::cout << "error: invalid segment in " << filename << std::endl;
+      std::abort();
+    }
+    // file contents are copied page-at-a-time
+    this->write(content + phdr.p_offset, phdr.p_paddr, phdr.p_filesz);
+
+    // zero-fill the remainder (.bss): pages already present are cleared now,
+    // the others when they are first touched
+    uint64_t page_size = uint64_t(1) << page_bits_;
+    uint64_t bss_start = uint64_t(phdr.p_paddr) + phdr.p_filesz;
+    uint64_t bss_end = uint64_t(phdr.p_paddr) + phdr.p_memsz;
+    if (bss_start < bss_end) {
+      zero_ranges_.push_back({bss_start, bss_end});
+      uint64_t head_end = std::min(bss_end, (bss_start + page_size - 1) & ~(page_size - 1));
+      if (bss_start < head_end) {
+        memset(this->get(bss_start), 0, head_end - bss_start);
+      }
+    }
+  }
 
-  this->clear();
+  if (entry) {
+    *entry = ehdr->e_entry;
+  }
 
-  while (true) {
-    if (line[0] == ':') {
-      uint32_t byteCount = hToI(line + 1, 2);
-      uint32_t nextAddr = hToI(line + 3, 4) + offset;
-      uint32_t key = hToI(line + 7, 2);
-      switch (key) {
-      case 0:
-        for (uint32_t i = 0; i < byteCount; i++) {
-          uint32_t addr  = nextAddr + i;
-          uint32_t value = hToI(line + 9 + i * 2, 2);
-          *this->get(addr) = value;
+  // look up the 'tohost' symbol
+  if (tohost) {
+    *tohost = 0;
+    if (ehdr->e_shentsize == sizeof(Elf32_Shdr)
+     && (ehdr->e_shoff + uint64_t(ehdr->e_shnum) * sizeof(Elf32_Shdr)) <= size) {
+      auto shdrs = (const Elf32_Shdr*)(content + ehdr->e_shoff);
+      for (uint32_t i = 0; i < ehdr->e_shnum; ++i) {
+        auto& shdr = shdrs[i];
+        if (shdr.sh_type != SHT_SYMTAB
+         || shdr.sh_link >= ehdr->e_shnum
+         || (uint64_t(shdr.sh_offset) + shdr.sh_size) > size)
+          continue;
+        auto& strtab = shdrs[shdr.sh_link];
+        if ((uint64_t(strtab.sh_offset) + strtab.sh_size) > size
+         || strtab.sh_size == 0
+         || content[strtab.sh_offset + strtab.sh_size - 1] != '\0')
+          continue;
+        auto syms = (const Elf32_Sym*)(content + shdr.sh_offset);
+        auto strs = (const char*)(content + strtab.sh_offset);
+        for (uint32_t j = 0, n = shdr.sh_size / sizeof(Elf32_Sym); j < n; ++j) {
+          if (syms[j].st_name < strtab.sh_size
+           && strcmp(strs + syms[j].st_name, "tohost") == 0) {
+            *tohost = syms[j].st_value;
+          }
         }
-        break;
-      case 2:
-        offset = hToI(line + 9, 4) << 4;
-        break;
-      case 4:
-        offset = hToI(line + 9, 4) << 16;
-        break;
-      default:
-        break;
       }
     }
-    while (*line != '\n' && size != 0) {
-      ++line;
-      --size;
-    }
-    if (size <= 1)
-      break;
-    ++line;
-    --size;
   }
+
+  munmap(data, size);
 }
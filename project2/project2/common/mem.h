@@ -28,6 +28,11 @@ public:
   virtual uint64_t size() const = 0;
   virtual void read(void* data, uint64_t addr, uint64_t size) = 0;
   virtual void write(const void* data, uint64_t addr, uint64_t size) = 0;
+
+  // host memory backing [addr, addr + size), nullptr if not directly addressable
+  virtual uint8_t* host_ptr(uint64_t /*addr*/, uint64_t /*size*/) {
+    return nullptr;
+  }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -83,8 +88,17 @@ public:
 
   MemoryUnit(uint64_t pageSize = 0);
 
+  struct mem_mapping_t {
+    MemDevice*  md;
+    uint64_t    start;
+    uint64_t    end;
+  };
+
   void attach(MemDevice &m, uint64_t start, uint64_t end);
 
+  // register several devices at once, later mappings take precedence
+  void attach(const std::vector<mem_mapping_t>& mappings);
+
   void read(void* data, uint64_t addr, uint64_t size, bool sup);
   void write(const void* data, uint64_t addr, uint64_t size, bool sup);
 
@@ -95,10 +109,24 @@ public:
   void tlbRm(uint64_t vaddr);
   void tlbFlush() {
     tlb_.clear();
+    this->htlbFlush();
   }
 
 private:
 
+  // direct-mapped host translation cache: virtual page -> host pointer
+  enum { HTLB_SIZE = 256, HTLB_PAGE_BITS = 12 };
+
+  struct htlb_entry_t {
+    uint64_t read_vpn;
+    uint64_t write_vpn;
+    uint8_t* host;
+  };
+
+  uint8_t* htlbFill(uint64_t addr, bool write);
+
+  void htlbFlush();
+
   struct amo_reservation_t {
     uint64_t addr;
     bool     valid;
@@ -106,13 +134,17 @@ private:
 
   class ADecoder {
   public:
-    ADecoder() {}
+    ADecoder() : index_dirty_(false), last_hit_(0) {}
     
     void read(void* data, uint64_t addr, uint64_t size);
     void write(const void* data, uint64_t addr, uint64_t size);
     
     void map(uint64_t start, uint64_t end, MemDevice &md);
 
+    void map(const std::vector<mem_mapping_t>& mappings);
+
+    uint8_t* host_ptr(uint64_t addr, uint64_t size);
+
   private:
 
     struct mem_accessor_t {
@@ -126,9 +158,23 @@ private:
       uint64_t    end;        
     };
 
-    bool lookup(uint64_t addr, uint32_t wordSize, mem_accessor_t*);
+    // non-overlapping address interval of a mapping
+    struct interval_t {
+      MemDevice*  md;
+      uint64_t    start;
+      uint64_t    end;
+      uint64_t    base;
+    };
+
+    // spanning accesses fall back to the latest mapping enclosing them
+    bool lookup(uint64_t addr, uint32_t wordSize, mem_accessor_t*, bool spanning = true);
+
+    void build_index();
 
     std::vector<entry_t> entries_;
+    std::vector<interval_t> index_;
+    bool index_dirty_;
+    uint32_t last_hit_;
   };
 
   struct TLBEntry {
@@ -146,6 +192,7 @@ private:
   uint64_t toPhyAddr(uint64_t vAddr, uint32_t flagMask);
 
   std::unordered_map<uint64_t, TLBEntry> tlb_;
+  std::vector<htlb_entry_t> htlb_;
   uint64_t  pageSize_;
   ADecoder  decoder_;  
   bool      enableVM_;
@@ -157,8 +204,14 @@ private:
 
 class RAM : public MemDevice {
 public:
+
+  // page lookup backends
+  enum Backend {
+    HashMap,    // hashed page index
+    PageTable   // two-level radix table over the 32-bit address space
+  };
   
-   RAM(uint32_t page_size, uint64_t capacity = 0);
+   RAM(uint32_t page_size, uint64_t capacity = 0, Backend backend = PageTable);
   ~RAM();
 
   void clear();
@@ -168,9 +221,18 @@ public:
   void read(void* data, uint64_t addr, uint64_t size) override;  
   void write(const void* data, uint64_t addr, uint64_t size) override;
 
-  void loadBinImage(const char* filename, uint64_t destination);
+  uint8_t* host_ptr(uint64_t addr, uint64_t size) override;
+
+  // use_mmap maps the image copy-on-write as the backing store of its pages
+  void loadBinImage(const char* filename, uint64_t destination, bool use_mmap = true);
   void loadHexImage(const char* filename);
 
+  // load the PT_LOAD segments of an ELF32 executable,
+  // returns its entry point and 'tohost' symbol address (0 if absent)
+  void loadElfImage(const char* filename, uint64_t* entry, uint64_t* tohost);
+
+  static bool isElfImage(const char* filename);
+
   uint8_t& operator[](uint64_t address) {
     return *this->get(address);
   }
@@ -183,9 +245,35 @@ private:
 
   uint8_t *get(uint64_t address) const;
 
+  uint8_t *lookup_page(uint64_t page_index) const;
+
+  uint8_t *&page_slot(uint64_t page_index) const;
+
+  uint8_t *alloc_page(uint64_t page_index) const;
+
+  void free_page(uint8_t* page) const;
+
+  bool mapBinImage(const char* filename, uint64_t destination);
+
+  struct mapping_t {
+    uint8_t* base;
+    uint64_t size;
+  };
+
+  struct addr_range_t {
+    uint64_t start;
+    uint64_t end;
+  };
+
   uint64_t capacity_;
   uint32_t page_bits_;  
+  Backend  backend_;
+  uint32_t l2_bits_;
+  mutable std::vector<uint8_t**> page_table_;
   mutable std::unordered_map<uint64_t, uint8_t*> pages_;
+  mutable uint64_t num_pages_;
+  std::vector<mapping_t> mappings_;
+  std::vector<addr_range_t> zero_ranges_;
   mutable uint8_t* last_page_;
   mutable uint64_t last_page_index_;
 };
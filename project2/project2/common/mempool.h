@@ -13,50 +13,80 @@
 
 #pragma once
 
-#include <stack>
+#include <cstdint>
+#include <new>
+
+// number of heap allocations performed by all memory pools,
+// which back the simulator events (SimPortEvent and SimCallEvent objects,
+// not the std::function inside a SimCallEvent)
+inline uint64_t& mempool_heap_allocs() {
+  static uint64_t s_count = 0;
+  return s_count;
+}
 
 template <typename T>
 class MemoryPool {
 public:  
-  MemoryPool(uint32_t max_size) : max_size_(max_size) {}
+  MemoryPool(uint32_t max_size) 
+    : free_list_(nullptr)
+    , free_size_(0)
+    , max_size_(max_size) 
+  {}
 
   MemoryPool(MemoryPool && other) 
-    : free_list_(std::move(other.free_list_)) 
-  {}
+    : free_list_(other.free_list_)
+    , free_size_(other.free_size_)
+    , max_size_(other.max_size_) {
+    other.free_list_ = nullptr;
+    other.free_size_ = 0;
+  }
 
   ~MemoryPool() {
     this->flush();
   }
 
   void* allocate() {
+    static_assert(sizeof(T) >= sizeof(free_node_t), "invalid object size");
     void* mem;
-    if (!free_list_.empty()) {
-      auto entry = free_list_.top();
-      free_list_.pop();
+    if (free_list_ != nullptr) {
+      auto entry = free_list_;
+      free_list_ = entry->next;
+      --free_size_;
       mem = static_cast<void*>(entry);      
     } else {
       mem = ::operator new(sizeof(T));
+      ++mempool_heap_allocs();
     }
     return mem;
   }
 
   void deallocate(void * object) {
-    if (free_list_.size() < max_size_) {
-      free_list_.push(static_cast<T*>(object));
+    if (free_size_ < max_size_) {
+      // the free list is stored inside the released objects
+      auto entry = static_cast<free_node_t*>(object);
+      entry->next = free_list_;
+      free_list_ = entry;
+      ++free_size_;
     } else {
       ::operator delete(object);
     }
   }
 
   void flush() {
-    while (!free_list_.empty()) {
-      auto entry = free_list_.top();
-      free_list_.pop();
+    while (free_list_ != nullptr) {
+      auto entry = free_list_;
+      free_list_ = entry->next;
       ::operator delete(entry);      
     }
+    free_size_ = 0;
   }
 
 private:
-  std::stack<T*> free_list_;
+  struct free_node_t {
+    free_node_t* next;
+  };
+
+  free_node_t* free_list_;
+  uint32_t free_size_;
   uint32_t max_size_;
 };
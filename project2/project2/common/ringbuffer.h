@@ -0,0 +1,74 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <assert.h>
+#include "bitmanip.h"
+
+// Bounded lock-free single-producer/single-consumer ring buffer
+template <typename T>
+class RingBuffer {
+public:
+  RingBuffer(uint32_t capacity)
+    : store_(capacity)
+    , mask_(capacity - 1)
+    , head_(0)
+    , tail_(0) {
+    assert(ispow2(capacity));
+  }
+
+  // producer side
+  bool try_push(const T& value) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == store_.size())
+      return false;
+    store_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  bool try_pop(T* value) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = store_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire)
+        == tail_.load(std::memory_order_acquire);
+  }
+
+  void clear() {
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+  uint32_t capacity() const {
+    return store_.size();
+  }
+
+private:
+  std::vector<T> store_;
+  uint64_t mask_;
+  // keep producer and consumer indices on separate cache lines
+  alignas(64) std::atomic<uint64_t> head_;
+  alignas(64) std::atomic<uint64_t> tail_;
+};
@@ -19,6 +19,8 @@
 #include <vector>
 #include <list>
 #include <queue>
+#include <algorithm>
+#include <cstdint>
 #include <assert.h>
 #include "mempool.h"
 
@@ -142,8 +144,6 @@ protected:
 
 class SimEventBase {
 public:
-  typedef std::shared_ptr<SimEventBase> Ptr;
-
   virtual ~SimEventBase() {}
   
   virtual void fire() const = 0;
@@ -153,9 +153,17 @@ public:
   }
 
 protected:
-  SimEventBase(uint64_t cycles) : cycles_(cycles) {}
+  SimEventBase(uint64_t cycles) 
+    : cycles_(cycles)
+    , next_(nullptr) 
+  {}
 
   uint64_t cycles_;
+
+  // intrusive link, events are owned by SimPlatform until fired
+  SimEventBase* next_;
+
+  friend class SimPlatform;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -250,6 +258,10 @@ private:
 
   virtual void do_tick() = 0;
 
+  virtual bool do_idle() const = 0;
+
+  virtual void do_skip(uint64_t cycles) = 0;
+
   std::string name_;
 
   friend class SimPlatform;
@@ -265,6 +277,15 @@ public:
   template <typename... Args>
   static Ptr Create(Args&&... args);
 
+  // an object is idle when its last tick did not change any state,
+  // by default objects are never idle and are ticked every cycle
+  bool idle() const {
+    return false;
+  }
+
+  // account for cycles skipped while the whole platform was idle
+  void skip(uint64_t /*cycles*/) {}
+
 protected:
 
   SimObject(const SimContext& ctx, const char* name) 
@@ -288,6 +309,14 @@ private:
   void do_tick() override {
     this->impl()->tick();
   }
+
+  bool do_idle() const override {
+    return this->impl()->idle();
+  }
+
+  void do_skip(uint64_t cycles) override {
+    this->impl()->skip(cycles);
+  }
 };
 
 class SimContext {
@@ -331,12 +360,12 @@ public:
                 const Pkt& pkt, 
                 uint64_t delay) {    
     assert(delay != 0);
-    auto evt = std::make_shared<SimCallEvent<Pkt>>(callback, pkt, cycles_ + delay);    
-    events_.emplace_back(evt);
+    auto evt = new SimCallEvent<Pkt>(callback, pkt, cycles_ + delay);    
+    this->insert_event(evt, delay);
   }
 
   void reset() {
-    events_.clear();
+    this->clear_events();
     for (auto& object : objects_) {
       object->do_reset();
     }
@@ -344,24 +373,32 @@ public:
   }
 
   void tick() {
-    // evaluate events
-    auto evt_it = events_.begin();
-    auto evt_it_end = events_.end();
-    while (evt_it != evt_it_end) {
-      auto& event = *evt_it;
-      if (cycles_ >= event->cycles()) {        
-        event->fire();
-        evt_it = events_.erase(evt_it);
-      } else {        
-        ++evt_it;
-      }
+    // evaluate events due this cycle
+    // the current bucket only holds events for cycles_,
+    // new events always land in other buckets or in the overflow heap
+    auto& bucket = wheel_[cycles_ & (WHEEL_SIZE - 1)];
+    while (bucket.head != nullptr) {
+      auto evt = bucket.head;
+      assert(evt->cycles() == cycles_);
+      bucket.head = evt->next_;
+      evt->fire();
+      delete evt;
     }
+    bucket.tail = nullptr;
     // evaluate components
     for (auto& object : objects_) {
       object->do_tick();
     }
     // advance clock    
     ++cycles_;
+    // fast-forward to the next event if no object made progress
+    this->skip_idle_cycles();
+    // move overflow events that are now within the wheel's horizon
+    while (!overflow_.empty() 
+        && overflow_.top().cycles < (cycles_ + WHEEL_SIZE)) {
+      wheel_[overflow_.top().cycles & (WHEEL_SIZE - 1)].push(overflow_.top().evt);
+      overflow_.pop();
+    }
   }
 
   uint64_t cycles() const {
@@ -370,7 +407,49 @@ public:
 
 private:
 
-  SimPlatform() : cycles_(0) {}
+  // timing wheel size, must be a power of two
+  // events further than WHEEL_SIZE-1 cycles ahead go to the overflow heap
+  enum {
+    WHEEL_SIZE = 256
+  };
+
+  struct bucket_t {
+    SimEventBase* head;
+    SimEventBase* tail;
+
+    bucket_t() : head(nullptr), tail(nullptr) {}
+
+    void push(SimEventBase* evt) {
+      evt->next_ = nullptr;
+      if (tail) {
+        tail->next_ = evt;
+      } else {
+        head = evt;
+      }
+      tail = evt;
+    }
+  };
+
+  struct overflow_entry_t {
+    uint64_t cycles;
+    uint64_t order;
+    SimEventBase* evt;
+  };
+
+  struct overflow_cmp_t {
+    bool operator()(const overflow_entry_t& lhs, const overflow_entry_t& rhs) const {
+      // min-heap on (cycles, order) to preserve scheduling order
+      if (lhs.cycles != rhs.cycles)
+        return lhs.cycles > rhs.cycles;
+      return lhs.order > rhs.order;
+    }
+  };
+
+  SimPlatform() 
+    : wheel_(WHEEL_SIZE)
+    , overflow_order_(0)
+    , cycles_(0) 
+  {}
 
   virtual ~SimPlatform() {
     this->clear();
@@ -378,18 +457,72 @@ private:
 
   void clear() {
     objects_.clear();
-    events_.clear();
+    this->clear_events();
+  }
+
+  void clear_events() {
+    for (auto& bucket : wheel_) {
+      while (bucket.head != nullptr) {
+        auto evt = bucket.head;
+        bucket.head = evt->next_;
+        delete evt;
+      }
+      bucket.tail = nullptr;
+    }
+    while (!overflow_.empty()) {
+      delete overflow_.top().evt;
+      overflow_.pop();
+    }
+    overflow_order_ = 0;
+  }
+
+  void skip_idle_cycles() {
+    for (auto& object : objects_) {
+      if (!object->do_idle())
+        return;
+    }
+    // find the next pending event
+    uint64_t next_cycles = UINT64_MAX;
+    for (uint64_t i = 0; i < WHEEL_SIZE; ++i) {
+      if (wheel_[(cycles_ + i) & (WHEEL_SIZE - 1)].head != nullptr) {
+        next_cycles = cycles_ + i;
+        break;
+      }
+    }
+    if (!overflow_.empty()) {
+      next_cycles = std::min(next_cycles, overflow_.top().cycles);
+    }
+    if (next_cycles == UINT64_MAX || next_cycles == cycles_)
+      return;
+    // nothing can change until that event fires
+    auto delta = next_cycles - cycles_;
+    for (auto& object : objects_) {
+      object->do_skip(delta);
+    }
+    cycles_ = next_cycles;
+  }
+
+  void insert_event(SimEventBase* evt, uint64_t delay) {
+    if (delay < WHEEL_SIZE) {
+      wheel_[evt->cycles() & (WHEEL_SIZE - 1)].push(evt);
+    } else {
+      overflow_.push({evt->cycles(), overflow_order_++, evt});
+    }
   }
 
   template <typename Pkt>
   void schedule(const SimPort<Pkt>* port, const Pkt& pkt, uint64_t delay) {
     assert(delay != 0);
-    auto evt = SimEventBase::Ptr(new SimPortEvent<Pkt>(port, pkt, cycles_ + delay));
-    events_.emplace_back(evt);
+    auto evt = new SimPortEvent<Pkt>(port, pkt, cycles_ + delay);
+    this->insert_event(evt, delay);
   }
 
   std::list<SimObjectBase::Ptr> objects_;
-  std::list<SimEventBase::Ptr> events_;
+  std::vector<bucket_t> wheel_;
+  std::priority_queue<overflow_entry_t, 
+                      std::vector<overflow_entry_t>, 
+                      overflow_cmp_t> overflow_;
+  uint64_t overflow_order_;
   uint64_t cycles_;
 
   template <typename U> friend class SimPort;
@@ -12,20 +12,28 @@
 // limitations under the License.
 
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
 #include <util.h>
 #include "types.h"
+#include "trace.h"
 #include "core.h"
 #include "debug.h"
 
 using namespace tinyrv;
 
-FunctionalUnit::FunctionalUnit(const SimContext& ctx, uint32_t latency)
-  : SimObject<FunctionalUnit>(ctx, "FunctionalUnit")
+FunctionalUnit::FunctionalUnit(const SimContext& ctx, const char* name, const Config& config)
+  : SimObject<FunctionalUnit>(ctx, name)
   , Input(this)
   , Output(this)
-  , latency_(latency) {
-  //--
+  , MemReqPort(this)
+  , MemRspPort(this)
+  , config_(config)
+  , busy_until_(config.num_units)
+  , idle_(false)
+  , next_tag_(0) {
+  assert(config.num_units != 0);
+  assert(config.interval != 0);
 }
 
 FunctionalUnit::~FunctionalUnit() {
@@ -33,13 +41,57 @@ FunctionalUnit::~FunctionalUnit() {
 }
 
 void FunctionalUnit::reset() {
-  //--
+  std::fill(busy_until_.begin(), busy_until_.end(), 0);
+  idle_ = false;
+  pending_.clear();
+  next_tag_ = 0;
+  perf_stats_ = PerfStats();
 }
 
 void FunctionalUnit::tick() {
-  if (Input.empty())
-    return;
-  auto trace = Input.front();
-  Output.send(trace, latency_);
-  Input.pop();
+  bool progress = false;
+
+  // completed memory accesses
+  while (!MemRspPort.empty()) {
+    auto& rsp = MemRspPort.front();
+    auto it = pending_.find(rsp.tag);
+    assert(it != pending_.end());
+    Output.send(it->second, 1);
+    pending_.erase(it);
+    MemRspPort.pop();
+    progress = true;
+  }
+
+  // each free unit accepts the next queued operation
+  auto cycles = SimPlatform::instance().cycles();
+  for (auto& busy_until : busy_until_) {
+    if (Input.empty())
+      break;
+    if (busy_until > cycles)
+      continue;
+    auto& entry = Input.front();
+    auto trace = entry.trace;
+    auto lsu_data = MemReqPort.connected() ? std::dynamic_pointer_cast<LsuTraceData>(trace->data) : nullptr;
+    if (lsu_data) {
+      uint32_t tag = next_tag_++;
+      pending_.emplace(tag, entry);
+      bool write = (trace->slu_op == LsuOp::STORE);
+      MemReqPort.send(MemReq{lsu_data->mem_addrs.addr, write, tag, trace->uuid, trace->PC}, 1);
+    } else {
+      Output.send(entry, config_.latency);
+    }
+    Input.pop();
+    busy_until = cycles + config_.interval;
+    ++perf_stats_.ops;
+    perf_stats_.busy_cycles += config_.interval;
+    progress = true;
+  }
+
+  // operations left waiting keep the unit awake
+  if (!Input.empty()) {
+    ++perf_stats_.stalls;
+    progress = true;
+  }
+
+  idle_ = !progress;
 }
\ No newline at end of file
@@ -13,14 +13,40 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
 #include <simobject.h>
+#include "types.h"
 
 namespace tinyrv {
 
 class Core;
 
+// Pool of identical execution units behind a shared input queue.
+// Each unit accepts a new operation every initiation interval and completes it
+// after the unit latency: an interval of 1 models a pipelined unit and an
+// interval equal to the latency a blocking one. Queued operations wait while
+// all units are busy.
 class FunctionalUnit : public SimObject<FunctionalUnit> {
 public:
+  struct Config {
+    uint32_t num_units; // unit instances
+    uint32_t latency;   // cycles to complete an operation
+    uint32_t interval;  // cycles between operations on the same unit
+  };
+
+  struct PerfStats {
+    uint64_t ops;
+    uint64_t busy_cycles; // unit cycles spent accepting operations
+    uint64_t stalls;      // cycles with queued operations and no free unit
+
+    PerfStats()
+      : ops(0)
+      , busy_cycles(0)
+      , stalls(0)
+    {}
+  };
+
   struct entry_t {
     pipeline_trace_t* trace;
     int rob_index;
@@ -30,7 +56,12 @@ public:
   SimPort<entry_t> Input;
   SimPort<entry_t> Output;
 
-  FunctionalUnit(const SimContext& ctx, uint32_t latency);
+  // memory accesses go through these ports when connected,
+  // the access latency then replaces the fixed unit latency
+  SimPort<MemReq> MemReqPort;
+  SimPort<MemRsp> MemRspPort;
+
+  FunctionalUnit(const SimContext& ctx, const char* name, const Config& config);
 
   ~FunctionalUnit();
 
@@ -38,9 +69,26 @@ public:
 
   void tick();
 
+  bool idle() const {
+    return idle_;
+  }
+
+  const Config& config() const {
+    return config_;
+  }
+
+  const PerfStats& perf_stats() const {
+    return perf_stats_;
+  }
+
 private:
 
-  uint32_t latency_;
+  Config config_;
+  std::vector<uint64_t> busy_until_; // per unit, cycle it accepts its next operation
+  bool idle_;
+  std::unordered_map<uint32_t, entry_t> pending_;
+  uint32_t next_tag_;
+  PerfStats perf_stats_;
 };
 
 }
\ No newline at end of file
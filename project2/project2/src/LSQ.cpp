@@ -0,0 +1,280 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <assert.h>
+#include <util.h>
+#include "types.h"
+#include "trace.h"
+#include "debug.h"
+#include "LSQ.h"
+
+using namespace tinyrv;
+
+LoadStoreQueue::LoadStoreQueue(const SimContext& ctx, uint32_t size, uint32_t ssit_size, uint32_t lfst_size)
+  : SimObject<LoadStoreQueue>(ctx, "LoadStoreQueue")
+  , Output(this)
+  , store_(size)
+  , predictor_(ssit_size, lfst_size) {
+  this->reset();
+}
+
+LoadStoreQueue::~LoadStoreQueue() {
+  for (auto& entry : store_) {
+    delete entry.drain_trace;
+  }
+}
+
+void LoadStoreQueue::reset() {
+  for (auto& entry : store_) {
+    entry.trace = nullptr;
+    entry.drain_trace = nullptr;
+  }
+  head_index_ = 0;
+  tail_index_ = 0;
+  count_ = 0;
+  next_seq_ = 1;
+  predictor_.reset();
+  idle_ = false;
+  perf_stats_ = PerfStats();
+}
+
+void LoadStoreQueue::tick() {
+  idle_ = true;
+
+  // retire committed loads and completed stores
+  while (!this->is_empty()) {
+    auto& head = store_[head_index_];
+    if (!head.committed || (head.store && !head.drained))
+      break;
+    delete head.drain_trace;
+    head.trace = nullptr;
+    head.drain_trace = nullptr;
+    head_index_ = this->next(head_index_);
+    --count_;
+    idle_ = false;
+  }
+}
+
+int LoadStoreQueue::allocate(pipeline_trace_t* trace, int rob_index) {
+  assert(!this->is_full());
+  int index = tail_index_;
+  auto& entry = store_[index];
+  entry.trace = trace;
+  entry.uuid = trace->uuid;
+  entry.seq = next_seq_++;
+  entry.PC = trace->PC;
+  entry.rob_index = rob_index;
+  entry.store = (trace->slu_op == LsuOp::STORE);
+  entry.addr_ready = false;
+  entry.data_ready = false;
+  entry.committed = false;
+  entry.addr = 0;
+  entry.size = 0;
+  entry.executed = false;
+  entry.src_seq = 0;
+  entry.dep_seq = 0;
+  entry.waited = false;
+  entry.drain_trace = nullptr;
+  entry.sent = false;
+  entry.drained = false;
+  auto lsu_data = std::dynamic_pointer_cast<LsuTraceData>(trace->data);
+  if (lsu_data) {
+    entry.addr = lsu_data->mem_addrs.addr;
+    entry.size = lsu_data->mem_addrs.size;
+  }
+  if (entry.store) {
+    ++perf_stats_.stores;
+    predictor_.store_dispatch(entry.PC, entry.seq);
+  } else {
+    ++perf_stats_.loads;
+    entry.dep_seq = predictor_.load_dispatch(entry.PC);
+    int dep = this->find_seq(entry.dep_seq);
+    if (dep >= 0) {
+      entry.dep_addr = store_[dep].addr;
+      entry.dep_size = store_[dep].size;
+    } else {
+      entry.dep_seq = 0;
+    }
+  }
+  tail_index_ = this->next(tail_index_);
+  ++count_;
+  return index;
+}
+
+int LoadStoreQueue::find(int rob_index) const {
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    auto& entry = store_[i];
+    if (!entry.committed && entry.rob_index == rob_index)
+      return i;
+  }
+  return -1;
+}
+
+int LoadStoreQueue::find_seq(uint64_t seq) const {
+  if (seq == 0)
+    return -1;
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    if (store_[i].seq == seq)
+      return i;
+  }
+  return -1;
+}
+
+bool LoadStoreQueue::store_addr_ready(int index) {
+  auto& store = store_.at(index);
+  assert(store.store);
+  if (store.addr_ready)
+    return false;
+  store.addr_ready = true;
+
+  // younger loads that already read older data missed this store
+  for (uint32_t i = this->next(index); i != tail_index_; i = this->next(i)) {
+    auto& load = store_[i];
+    if (load.store || !load.executed || load.src_seq > store.seq)
+      continue;
+    if (store.addr < (load.addr + load.size)
+     && load.addr < (store.addr + store.size)) {
+      DT(3, "*** memory order violation: load PC=0x" << std::hex << load.PC << ", store PC=0x" << store.PC << std::dec << " (#" << load.uuid << ")");
+      ++perf_stats_.violations;
+      predictor_.violation(load.PC, store.PC);
+      // the load is considered to have read the store data,
+      // the replay is only modeled by the issue stall
+      load.src_seq = store.seq;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LoadStoreQueue::store_data_ready(int index) {
+  auto& entry = store_.at(index);
+  assert(entry.store && entry.addr_ready);
+  entry.data_ready = true;
+  predictor_.store_execute(entry.PC, entry.seq);
+}
+
+void LoadStoreQueue::load_executed(entry_t& load, uint64_t src_seq) {
+  load.executed = true;
+  load.src_seq = src_seq;
+  if (load.waited
+   && !(load.dep_addr < (load.addr + load.size) && load.addr < (load.dep_addr + load.dep_size))) {
+    ++perf_stats_.false_deps;
+  }
+}
+
+LoadStoreQueue::LoadStatus LoadStoreQueue::check_load(int index) {
+  auto& load = store_.at(index);
+  assert(!load.store);
+
+  // wait for the predicted store to execute
+  int dep = this->find_seq(load.dep_seq);
+  if (dep >= 0 && !store_[dep].data_ready) {
+    load.waited = true;
+    ++perf_stats_.load_blocks;
+    return LOAD_BLOCKED;
+  }
+
+  // find the youngest older store writing to the load bytes
+  int match = -1;
+  bool speculative = false;
+  for (uint32_t i = head_index_; i != uint32_t(index); i = this->next(i)) {
+    auto& entry = store_[i];
+    if (!entry.store)
+      continue;
+    if (!entry.addr_ready) {
+      if (predictor_.enabled()) {
+        // predicted independent
+        speculative = true;
+        continue;
+      }
+      ++perf_stats_.load_blocks;
+      return LOAD_BLOCKED;
+    }
+    if (entry.addr < (load.addr + load.size)
+     && load.addr < (entry.addr + entry.size)) {
+      match = i;
+    }
+  }
+
+  if (match < 0) {
+    perf_stats_.speculative += speculative;
+    this->load_executed(load, 0);
+    return LOAD_MEMORY;
+  }
+
+  // only a store covering the whole load can forward its data
+  auto& store = store_[match];
+  if (store.data_ready
+   && store.addr <= load.addr
+   && (load.addr + load.size) <= (store.addr + store.size)) {
+    ++perf_stats_.forwards;
+    perf_stats_.speculative += speculative;
+    this->load_executed(load, store.seq);
+    return LOAD_FORWARD;
+  }
+
+  ++perf_stats_.load_blocks;
+  return LOAD_BLOCKED;
+}
+
+void LoadStoreQueue::commit(pipeline_trace_t* trace) {
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    auto& entry = store_[i];
+    if (entry.trace == trace) {
+      assert(!entry.committed);
+      // the pipeline releases the trace on commit,
+      // stores keep a copy for their memory write
+      entry.committed = true;
+      entry.trace = nullptr;
+      if (entry.store) {
+        entry.drain_trace = new pipeline_trace_t(*trace);
+      }
+      return;
+    }
+  }
+  assert(false);
+}
+
+pipeline_trace_t* LoadStoreQueue::next_drain() {
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    auto& entry = store_[i];
+    if (!entry.committed)
+      break;
+    if (entry.store && !entry.sent) {
+      entry.sent = true;
+      return entry.drain_trace;
+    }
+  }
+  return nullptr;
+}
+
+void LoadStoreQueue::drained(pipeline_trace_t* trace) {
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    auto& entry = store_[i];
+    if (entry.drain_trace == trace) {
+      entry.drained = true;
+      return;
+    }
+  }
+  assert(false);
+}
+
+void LoadStoreQueue::dump() {
+  for (uint32_t i = head_index_, n = 0; n < count_; i = this->next(i), ++n) {
+    auto& entry = store_[i];
+    DT(4, "LSQ[" << i << "] " << (entry.store ? "store" : "load") << " addr=0x" << std::hex << entry.addr << std::dec 
+       << ", size=" << entry.size << ", ready=" << entry.addr_ready << entry.data_ready << ", committed=" << entry.committed << ", drained=" << entry.drained);
+    __unused (entry);
+  }
+}
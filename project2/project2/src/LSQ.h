@@ -0,0 +1,167 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include <simobject.h>
+#include "FU.h"
+#include "storeset.h"
+
+namespace tinyrv {
+
+// Load/store queue, holding the memory operations in program order.
+// A store address is known once its base register is available, and its data
+// once the stored register is; stores only write memory after they commit and
+// stay in the queue until that write completes. Loads check the older stores
+// before accessing memory: the youngest overlapping store forwards its data
+// when it covers the whole load, while pending store data and partial
+// overlaps hold the load back. Without a store-set predictor loads also wait
+// for every older store address; with it they only wait for the store their
+// set predicts, and a store resolving its address under a younger load that
+// read older data reports an ordering violation and trains the predictor.
+// A violation only costs a fixed issue stall (LSQ_REPLAY_PENALTY): the load
+// and its dependents are not squashed or re-executed, so their timing stays
+// as if the speculation had been correct.
+class LoadStoreQueue : public SimObject<LoadStoreQueue> {
+public:
+  enum LoadStatus {
+    LOAD_BLOCKED,
+    LOAD_FORWARD,
+    LOAD_MEMORY
+  };
+
+  struct PerfStats {
+    uint64_t loads;
+    uint64_t stores;
+    uint64_t forwards;
+    uint64_t load_blocks;
+    uint64_t full_stalls;
+    uint64_t speculative;  // loads issued ahead of unresolved stores
+    uint64_t violations;   // speculative loads that read stale data
+    uint64_t false_deps;   // predicted waits on non-overlapping stores
+    uint64_t replay_stalls;
+
+    PerfStats()
+      : loads(0)
+      , stores(0)
+      , forwards(0)
+      , load_blocks(0)
+      , full_stalls(0)
+      , speculative(0)
+      , violations(0)
+      , false_deps(0)
+      , replay_stalls(0)
+    {}
+  };
+
+  // completions of forwarded loads and of stores
+  SimPort<FunctionalUnit::entry_t> Output;
+
+  LoadStoreQueue(const SimContext& ctx, uint32_t size, uint32_t ssit_size, uint32_t lfst_size);
+
+  ~LoadStoreQueue();
+
+  void reset();
+
+  void tick();
+
+  // a head entry that can retire on the next tick keeps the queue busy,
+  // drained stores are released after the queue has ticked
+  bool idle() const {
+    if (!idle_ || this->is_empty())
+      return idle_;
+    auto& head = store_[head_index_];
+    return !(head.committed && (!head.store || head.drained));
+  }
+
+  int allocate(pipeline_trace_t* trace, int rob_index);
+
+  // queue index of an uncommitted instruction
+  int find(int rob_index) const;
+
+  // the store address is available,
+  // returns true when a younger load has violated the memory order
+  bool store_addr_ready(int index);
+
+  // the store data is available
+  void store_data_ready(int index);
+
+  LoadStatus check_load(int index);
+
+  void commit(pipeline_trace_t* trace);
+
+  // copy of the oldest committed store not yet sent to memory, or nullptr
+  pipeline_trace_t* next_drain();
+
+  void drained(pipeline_trace_t* trace);
+
+  bool is_full() const {
+    return (count_ == store_.size());
+  }
+
+  bool is_empty() const {
+    return (count_ == 0);
+  }
+
+  PerfStats& perf_stats() {
+    return perf_stats_;
+  }
+
+  void dump();
+
+private:
+
+  struct entry_t {
+    pipeline_trace_t* trace;
+    uint64_t uuid;
+    uint64_t seq;       // allocation order, from 1
+    Word     PC;
+    int      rob_index;
+    bool     store;
+    bool     addr_ready;
+    bool     data_ready;
+    bool     committed;
+    uint64_t addr;
+    uint32_t size;
+    bool     executed;  // load has read its data
+    uint64_t src_seq;   // store the load read from, 0 for memory
+    uint64_t dep_seq;   // predicted store dependence
+    uint64_t dep_addr;
+    uint32_t dep_size;
+    bool     waited;
+    pipeline_trace_t* drain_trace;
+    bool     sent;
+    bool     drained;
+  };
+
+  uint32_t next(uint32_t index) const {
+    return (index + 1) % store_.size();
+  }
+
+  // queue index of an in-flight entry, -1 once retired
+  int find_seq(uint64_t seq) const;
+
+  void load_executed(entry_t& load, uint64_t src_seq);
+
+  std::vector<entry_t> store_;
+  StoreSetPredictor predictor_;
+  uint32_t head_index_;
+  uint32_t tail_index_;
+  uint32_t count_;
+  uint64_t next_seq_;
+  bool     idle_;
+  PerfStats perf_stats_;
+};
+
+}
@@ -21,12 +21,13 @@
 
 using namespace tinyrv;
 
-ReorderBuffer::ReorderBuffer(const SimContext& ctx, Scoreboard* scoreboard, uint32_t size) 
+ReorderBuffer::ReorderBuffer(const SimContext& ctx, Scoreboard* scoreboard, uint32_t size, uint32_t commit_width) 
   : SimObject<ReorderBuffer>(ctx, "ReorderBuffer")
   , Completed(this)
   , Committed(this)
   , scoreboard_(scoreboard)
-  , store_(size) {
+  , store_(size)
+  , commit_width_(commit_width) {
   this->reset();
 }
 
@@ -42,41 +43,49 @@ void ReorderBuffer::reset() {
   head_index_ = 0;
   tail_index_ = 0;
   count_ = 0;
+  idle_ = false;
 }
 
 void ReorderBuffer::tick() {
+  idle_ = true;
+
   if (this->is_empty())
     return;
 
   auto& RAT = scoreboard_->RAT_;
   
-  // check if we have a completed instruction
-  if (!Completed.empty()) {
+  // check if we have completed instructions
+  while (!Completed.empty()) {
     // mark its entry as completed
     int rob_index = Completed.front();
     store_[rob_index].completed = true;
     Completed.pop();
+    idle_ = false;
   }
 
-  // get the head entry
-  auto& head = store_[head_index_];
-  
-  // TODO:
-  // check if head entry has completed
-  // clear the RAT if it is still pointing to this ROB entry
-  // use the destination register from trace to access the RAT    
-  // Warning: only update the RAT for instructions that write to the register file 
-  // push the trace into commit port (using this->Committed.send())
-  // remove the head entry
-  // HERE!
-  if(head.completed == true){
+  // retire up to commit_width completed head entries
+  for (uint32_t n = 0; n < commit_width_ && !this->is_empty(); ++n) {
+    // get the head entry
+    auto& head = store_[head_index_];
+    
+    // TODO:
+    // check if head entry has completed
+    // clear the RAT if it is still pointing to this ROB entry
+    // use the destination register from trace to access the RAT    
+    // Warning: only update the RAT for instructions that write to the register file 
+    // push the trace into commit port (using this->Committed.send())
+    // remove the head entry
+    // HERE!
+    if (!head.completed)
+      break;
     if(head.trace->wb&&RAT.get(head.trace->rd)==head_index_){
       RAT.set(head.trace->rd, -1);
     }
     this->Committed.send(head.trace);
     this->pop();
-    // std::cout << "infinite loop tick";
-}}
+    idle_ = false;
+  }
+}
 
 int ReorderBuffer::allocate(pipeline_trace_t* trace) {
   assert(!this->is_full());
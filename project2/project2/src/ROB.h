@@ -26,7 +26,7 @@ public:
   SimPort<int> Completed;
   SimPort<pipeline_trace_t*> Committed;
 
-  ReorderBuffer(const SimContext& ctx, Scoreboard* scoreboard, uint32_t size);
+  ReorderBuffer(const SimContext& ctx, Scoreboard* scoreboard, uint32_t size, uint32_t commit_width = 1);
 
   ~ReorderBuffer();
 
@@ -34,6 +34,10 @@ public:
 
   void tick();
 
+  bool idle() const {
+    return idle_;
+  }
+
   int allocate(pipeline_trace_t* trace);
 
   int pop();
@@ -42,6 +46,11 @@ public:
 
   bool is_empty() const;
 
+  // distance of an allocated entry from the head, 0 is the oldest
+  uint32_t age(int rob_index) const {
+    return (rob_index - head_index_ + store_.size()) % store_.size();
+  }
+
   void dump();
 
 private:
@@ -53,9 +62,11 @@ private:
   
   Scoreboard* scoreboard_;
   std::vector<rob_entry_t> store_;
+  uint32_t commit_width_;
   int head_index_;
   int tail_index_;
   uint32_t count_;  
+  bool idle_;
 };
 
 }
\ No newline at end of file
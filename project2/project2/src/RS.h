@@ -13,9 +13,15 @@
 // limitations under the License.
 
 #include <vector>
+#include <util.h>
 
 namespace tinyrv {
 
+// Reservation station entries with bitmask wakeup and select.
+// Each producer entry keeps a bitmask of the entries waiting on its result,
+// so a broadcast only visits its dependents, and a ready bitmask tracks the
+// entries with all operands available that are not yet running, so select
+// scans it with count-trailing-zeros in index order.
 class ReservationStation {
 public:
 
@@ -31,7 +37,11 @@ public:
   ReservationStation(uint32_t size) 
     : store_(size)
     , indices_(size)
-    , next_index_(0) {
+    , next_index_(0)
+    , num_words_((size + 63) / 64)
+    , ready_(num_words_, 0)
+    , valid_(num_words_, 0)
+    , dependents_(size * num_words_, 0) {
     for (uint32_t i = 0; i < size; ++i) {
       store_[i].valid = false;
       indices_[i] = i;
@@ -44,15 +54,67 @@ public:
     assert(!this->is_full());
     int index = indices_[next_index_++];
     store_[index] = {true, false, rob_index, rs1_index, rs2_index, trace};
+    set_bit(valid_.data(), index);
+    if (rs1_index != -1) {
+      set_bit(&dependents_[rs1_index * num_words_], index);
+    }
+    if (rs2_index != -1) {
+      set_bit(&dependents_[rs2_index * num_words_], index);
+    }
+    if (rs1_index == -1 && rs2_index == -1) {
+      set_bit(ready_.data(), index);
+    }
     return index;
   }
 
   void remove(uint32_t index) {
     assert(index < store_.size() && !this->is_empty());
     store_[index].valid = false;
+    clear_bit(valid_.data(), index);
+    clear_bit(ready_.data(), index);
     indices_[--next_index_] = index;    
   }
 
+  // the entry was sent to its functional unit
+  void set_running(uint32_t index) {
+    assert(store_[index].valid && !store_[index].running);
+    store_[index].running = true;
+    clear_bit(ready_.data(), index);
+  }
+
+  // broadcast a producer's result to its dependents
+  void wakeup(uint32_t producer) {
+    auto deps = &dependents_[producer * num_words_];
+    for (uint32_t w = 0; w < num_words_; ++w) {
+      uint64_t bits = deps[w];
+      while (bits != 0) {
+        uint32_t index = w * 64 + count_trailing_zeros64(bits);
+        bits &= bits - 1;
+        auto& entry = store_[index];
+        if (entry.rs1_index == int(producer)) {
+          entry.rs1_index = -1;
+        }
+        if (entry.rs2_index == int(producer)) {
+          entry.rs2_index = -1;
+        }
+        if (entry.rs1_index == -1 && entry.rs2_index == -1 && !entry.running) {
+          set_bit(ready_.data(), index);
+        }
+      }
+      deps[w] = 0;
+    }
+  }
+
+  // first ready entry at or after index, -1 if none
+  int next_ready(uint32_t index) const {
+    return find_next(ready_.data(), index);
+  }
+
+  // first valid entry at or after index, -1 if none
+  int next_valid(uint32_t index) const {
+    return find_next(valid_.data(), index);
+  }
+
   entry_t& operator[](uint32_t index) {
     return store_[index];
   }
@@ -84,9 +146,33 @@ public:
 
 private:
 
+  static void set_bit(uint64_t* words, uint32_t index) {
+    words[index / 64] |= (uint64_t(1) << (index % 64));
+  }
+
+  static void clear_bit(uint64_t* words, uint32_t index) {
+    words[index / 64] &= ~(uint64_t(1) << (index % 64));
+  }
+
+  int find_next(const uint64_t* words, uint32_t index) const {
+    for (uint32_t w = index / 64; w < num_words_; ++w) {
+      uint64_t bits = words[w];
+      if (w == index / 64) {
+        bits &= ~uint64_t(0) << (index % 64);
+      }
+      if (bits != 0)
+        return w * 64 + count_trailing_zeros64(bits);
+    }
+    return -1;
+  }
+
   std::vector<entry_t> store_;
   std::vector<uint32_t> indices_;
   uint32_t next_index_;
+  uint32_t num_words_;
+  std::vector<uint64_t> ready_;
+  std::vector<uint64_t> valid_;
+  std::vector<uint64_t> dependents_; // num_words_ per producer entry
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,317 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <assert.h>
+#include <util.h>
+#include "cache.h"
+#include "debug.h"
+
+using namespace tinyrv;
+
+CacheSim::CacheSim(const SimContext& ctx, const char* name, const Config& config)
+  : SimObject<CacheSim>(ctx, name)
+  , CoreReqPorts(config.num_inputs, this)
+  , CoreRspPorts(config.num_inputs, this)
+  , MemReqPort(this)
+  , MemRspPort(this)
+  , config_(config)
+  , line_bits_(log2ceil(config.line_size))
+  , num_sets_(config.size / (config.ways * config.line_size))
+  , lines_(config.size / config.line_size)
+  , plru_(num_sets_)
+  , mshrs_(config.mshr_size) {
+  assert(config.mshr_size != 0);
+  assert(config.num_inputs != 0);
+  assert(ispow2(config.line_size));
+  assert(ispow2(config.ways) && config.ways <= 64);
+  assert(ispow2(num_sets_));
+  set_bits_ = log2ceil(num_sets_);
+  this->reset();
+}
+
+CacheSim::~CacheSim() {
+  //--
+}
+
+void CacheSim::reset() {
+  for (auto& line : lines_) {
+    line.valid = false;
+    line.dirty = false;
+    line.prefetched = false;
+    line.tag = 0;
+    line.last_use = 0;
+  }
+  std::fill(plru_.begin(), plru_.end(), 0);
+  use_counter_ = 0;
+  for (auto& mshr : mshrs_) {
+    mshr.valid = false;
+    mshr.reqs.clear();
+  }
+  pending_mshrs_ = 0;
+  next_input_ = 0;
+  if (prefetcher_) {
+    prefetcher_->reset();
+  }
+  idle_ = false;
+  perf_stats_ = PerfStats();
+}
+
+void CacheSim::tick() {
+  bool progress = false;
+
+  // complete the filled lines, in any order
+  while (!MemRspPort.empty()) {
+    auto& mshr = mshrs_.at(MemRspPort.front().tag);
+    assert(mshr.valid);
+    uint32_t set = mshr.line & (num_sets_ - 1);
+    uint32_t way = this->fill(set, mshr.line >> set_bits_);
+    // lines no demand request waited for stay tagged as prefetched
+    lines_[set * config_.ways + way].prefetched = mshr.reqs.empty();
+    for (auto& entry : mshr.reqs) {
+      if (entry.req.write) {
+        lines_[set * config_.ways + way].dirty = true;
+      }
+      DT(3, this->name() << "-fill: " << entry.req);
+      this->respond(entry.req, entry.input);
+    }
+    mshr.reqs.clear();
+    mshr.valid = false;
+    --pending_mshrs_;
+    MemRspPort.pop();
+    progress = true;
+  }
+
+  // select the next client request
+  int input = -1;
+  for (uint32_t i = 0, n = CoreReqPorts.size(); i < n; ++i) {
+    uint32_t idx = (next_input_ + i) % n;
+    if (!CoreReqPorts[idx].empty()) {
+      input = idx;
+      break;
+    }
+  }
+
+  // process the request
+  if (input >= 0) {
+    auto& req_port = CoreReqPorts[input];
+    auto& req = req_port.front();
+    uint64_t line = req.addr >> line_bits_;
+    uint32_t set = line & (num_sets_ - 1);
+    int way = this->lookup(set, line >> set_bits_);
+    if (way >= 0) {
+      // hit, possibly under outstanding misses
+      this->process(req, true);
+      perf_stats_.hits_under_miss += (pending_mshrs_ != 0);
+      this->touch(set, way);
+      auto& hit_line = lines_[set * config_.ways + way];
+      if (req.write) {
+        hit_line.dirty = true;
+      }
+      bool pf_hit = hit_line.prefetched;
+      if (pf_hit) {
+        ++perf_stats_.pf_useful;
+        hit_line.prefetched = false;
+      }
+      DT(3, this->name() << "-hit: " << req);
+      this->respond(req, input);
+      if (!req.write || config_.write_ack) {
+        this->prefetch(req, pf_hit);
+      }
+      req_port.pop();
+      progress = true;
+    } else {
+      // merge secondary misses into the line's MSHR
+      int free_mshr;
+      int line_mshr = this->find_mshr(line, &free_mshr);
+      if (line_mshr >= 0) {
+        DT(3, this->name() << "-merge: " << req);
+        this->process(req, false);
+        ++perf_stats_.mshr_merges;
+        auto& mshr = mshrs_[line_mshr];
+        if (mshr.prefetch && mshr.reqs.empty()) {
+          ++perf_stats_.pf_late;
+        }
+        mshr.reqs.push_back({req, uint32_t(input)});
+        if (!req.write || config_.write_ack) {
+          this->prefetch(req, true);
+        }
+        req_port.pop();
+        progress = true;
+      } else if (req.write && !config_.write_ack) {
+        // line writeback, allocate without fetching
+        DT(3, this->name() << "-writeback: " << req);
+        this->process(req, false);
+        uint32_t way = this->fill(set, line >> set_bits_);
+        lines_[set * config_.ways + way].dirty = true;
+        req_port.pop();
+        progress = true;
+      } else if (free_mshr >= 0) {
+        DT(3, this->name() << "-miss: " << req);
+        this->process(req, false);
+        auto& mshr = mshrs_[free_mshr];
+        mshr.valid = true;
+        mshr.line = line;
+        mshr.prefetch = false;
+        mshr.reqs.push_back({req, uint32_t(input)});
+        ++pending_mshrs_;
+        MemReqPort.send(MemReq{line << line_bits_, false, uint32_t(free_mshr), req.uuid, req.PC}, 1);
+        this->prefetch(req, true);
+        req_port.pop();
+        progress = true;
+      } else {
+        // all MSHRs busy, retry next cycle
+        ++perf_stats_.mshr_stalls;
+      }
+    }
+    next_input_ = (input + 1) % CoreReqPorts.size();
+  }
+
+  idle_ = !progress;
+}
+
+void CacheSim::process(const MemReq& req, bool hit) {
+  if (req.write) {
+    ++perf_stats_.writes;
+    perf_stats_.write_misses += !hit;
+  } else {
+    ++perf_stats_.reads;
+    perf_stats_.read_misses += !hit;
+  }
+}
+
+void CacheSim::respond(const MemReq& req, uint32_t input) {
+  if (req.write && !config_.write_ack)
+    return;
+  CoreRspPorts.at(input).send(MemRsp{req.tag, req.uuid}, config_.latency);
+}
+
+int CacheSim::find_mshr(uint64_t line, int* free_mshr) const {
+  *free_mshr = -1;
+  for (uint32_t i = 0, n = mshrs_.size(); i < n; ++i) {
+    if (!mshrs_[i].valid) {
+      if (*free_mshr < 0) {
+        *free_mshr = i;
+      }
+    } else if (mshrs_[i].line == line) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void CacheSim::prefetch(const MemReq& req, bool trigger) {
+  if (!prefetcher_)
+    return;
+
+  prefetches_.clear();
+  prefetcher_->access(req.PC, req.addr, trigger, prefetches_);
+
+  for (auto addr : prefetches_) {
+    uint64_t line = addr >> line_bits_;
+    uint32_t set = line & (num_sets_ - 1);
+    if (this->lookup(set, line >> set_bits_) >= 0)
+      continue;
+    int free_mshr;
+    if (this->find_mshr(line, &free_mshr) >= 0)
+      continue;
+    if (free_mshr < 0 || (pending_mshrs_ + 1) >= mshrs_.size()) {
+      ++perf_stats_.pf_dropped;
+      continue;
+    }
+    DT(3, this->name() << "-prefetch: addr=0x" << std::hex << (line << line_bits_) << std::dec << " (#" << req.uuid << ")");
+    auto& mshr = mshrs_[free_mshr];
+    mshr.valid = true;
+    mshr.line = line;
+    mshr.prefetch = true;
+    ++pending_mshrs_;
+    ++perf_stats_.pf_issued;
+    MemReqPort.send(MemReq{line << line_bits_, false, uint32_t(free_mshr), req.uuid, req.PC}, 1);
+  }
+}
+
+int CacheSim::lookup(uint32_t set, uint64_t tag) const {
+  auto lines = &lines_[set * config_.ways];
+  for (uint32_t i = 0; i < config_.ways; ++i) {
+    if (lines[i].valid && lines[i].tag == tag)
+      return i;
+  }
+  return -1;
+}
+
+uint32_t CacheSim::select_victim(uint32_t set) const {
+  auto lines = &lines_[set * config_.ways];
+  for (uint32_t i = 0; i < config_.ways; ++i) {
+    if (!lines[i].valid)
+      return i;
+  }
+
+  if (config_.policy == PLRU) {
+    // follow the tree bits towards the least recently used half
+    uint64_t bits = plru_[set];
+    uint32_t way = 0;
+    uint32_t node = 0;
+    for (uint32_t l = 0, levels = log2ceil(config_.ways); l < levels; ++l) {
+      uint32_t bit = (bits >> node) & 0x1;
+      way = (way << 1) | bit;
+      node = 2 * node + 1 + bit;
+    }
+    return way;
+  }
+
+  uint32_t victim = 0;
+  for (uint32_t i = 1; i < config_.ways; ++i) {
+    if (lines[i].last_use < lines[victim].last_use) {
+      victim = i;
+    }
+  }
+  return victim;
+}
+
+void CacheSim::touch(uint32_t set, uint32_t way) {
+  lines_[set * config_.ways + way].last_use = ++use_counter_;
+
+  // point the tree bits away from the accessed way
+  auto& bits = plru_[set];
+  uint32_t node = 0;
+  for (int l = log2ceil(config_.ways) - 1; l >= 0; --l) {
+    uint32_t bit = (way >> l) & 0x1;
+    if (bit) {
+      bits &= ~(uint64_t(1) << node);
+    } else {
+      bits |= (uint64_t(1) << node);
+    }
+    node = 2 * node + 1 + bit;
+  }
+}
+
+uint32_t CacheSim::fill(uint32_t set, uint64_t tag) {
+  uint32_t way = this->select_victim(set);
+  auto& line = lines_[set * config_.ways + way];
+  if (line.valid) {
+    ++perf_stats_.evictions;
+    perf_stats_.pf_unused += line.prefetched;
+    if (line.dirty) {
+      // write back the victim, no response is expected
+      ++perf_stats_.writebacks;
+      uint64_t addr = ((line.tag << set_bits_) | set) << line_bits_;
+      MemReqPort.send(MemReq{addr, true, 0, 0, 0}, 1);
+    }
+  }
+  line.valid = true;
+  line.dirty = false;
+  line.prefetched = false;
+  line.tag = tag;
+  this->touch(set, way);
+  return way;
+}
@@ -0,0 +1,176 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <simobject.h>
+#include "types.h"
+#include "prefetcher.h"
+
+namespace tinyrv {
+
+// Set-associative write-back, write-allocate cache timing model.
+// Requests arrive on the CoreReqPorts, one per client arbitrated round-robin,
+// and are answered on the matching CoreRspPorts after the hit latency;
+// misses fetch the line through MemReqPort/MemRspPort.
+// Without write_ack, writes are line writebacks from an upper cache level:
+// they are not answered and a missing line is allocated without a fetch.
+// An optional prefetcher observes the demand accesses; its lines are fetched
+// into free MSHRs, keeping one for demand misses.
+// The cache is non-blocking: each missing line holds an MSHR that collects
+// the secondary misses to that line, hits are served under outstanding misses
+// and requests only stall when all MSHRs are busy.
+class CacheSim : public SimObject<CacheSim> {
+public:
+  enum ReplPolicy {
+    LRU,
+    PLRU
+  };
+
+  struct Config {
+    uint32_t   size;      // capacity in bytes
+    uint32_t   ways;      // associativity
+    uint32_t   line_size; // line size in bytes
+    uint32_t   latency;   // hit latency
+    uint32_t   mshr_size; // outstanding missing lines
+    uint32_t   num_inputs; // client channels
+    bool       write_ack; // answer write requests
+    ReplPolicy policy;
+  };
+
+  struct PerfStats {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_misses;
+    uint64_t write_misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t mshr_merges;
+    uint64_t mshr_stalls;
+    uint64_t hits_under_miss;
+    uint64_t pf_issued;   // prefetches sent to memory
+    uint64_t pf_useful;   // prefetched lines hit before eviction
+    uint64_t pf_late;     // demand misses merged into a prefetch
+    uint64_t pf_unused;   // prefetched lines evicted untouched
+    uint64_t pf_dropped;  // prefetches without a free MSHR
+
+    PerfStats()
+      : reads(0)
+      , writes(0)
+      , read_misses(0)
+      , write_misses(0)
+      , evictions(0)
+      , writebacks(0)
+      , mshr_merges(0)
+      , mshr_stalls(0)
+      , hits_under_miss(0)
+      , pf_issued(0)
+      , pf_useful(0)
+      , pf_late(0)
+      , pf_unused(0)
+      , pf_dropped(0)
+    {}
+  };
+
+  std::vector<SimPort<MemReq>> CoreReqPorts;
+  std::vector<SimPort<MemRsp>> CoreRspPorts;
+  SimPort<MemReq> MemReqPort;
+  SimPort<MemRsp> MemRspPort;
+
+  CacheSim(const SimContext& ctx, const char* name, const Config& config);
+
+  ~CacheSim();
+
+  void reset();
+
+  void tick();
+
+  bool idle() const {
+    return idle_;
+  }
+
+  // the cache takes ownership of the prefetcher
+  void set_prefetcher(Prefetcher* prefetcher) {
+    prefetcher_.reset(prefetcher);
+  }
+
+  const Prefetcher* prefetcher() const {
+    return prefetcher_.get();
+  }
+
+  const PerfStats& perf_stats() const {
+    return perf_stats_;
+  }
+
+  // line address of a byte address
+  uint64_t line_addr(uint64_t addr) const {
+    return addr >> line_bits_;
+  }
+
+private:
+
+  struct line_t {
+    bool     valid;
+    bool     dirty;
+    bool     prefetched;
+    uint64_t tag;
+    uint64_t last_use;
+  };
+
+  struct mshr_req_t {
+    MemReq   req;
+    uint32_t input;
+  };
+
+  struct mshr_t {
+    bool     valid;
+    uint64_t line;
+    bool     prefetch;
+    std::vector<mshr_req_t> reqs;
+  };
+
+  int lookup(uint32_t set, uint64_t tag) const;
+
+  uint32_t select_victim(uint32_t set) const;
+
+  void touch(uint32_t set, uint32_t way);
+
+  uint32_t fill(uint32_t set, uint64_t tag);
+
+  void process(const MemReq& req, bool hit);
+
+  void respond(const MemReq& req, uint32_t input);
+
+  int find_mshr(uint64_t line, int* free_mshr) const;
+
+  void prefetch(const MemReq& req, bool trigger);
+
+  Config   config_;
+  uint32_t line_bits_;
+  uint32_t set_bits_;
+  uint32_t num_sets_;
+  std::vector<line_t>   lines_;
+  std::vector<uint64_t> plru_;
+  uint64_t use_counter_;
+  std::vector<mshr_t> mshrs_;
+  uint32_t pending_mshrs_;
+  uint32_t next_input_;
+  std::unique_ptr<Prefetcher> prefetcher_;
+  std::vector<uint64_t> prefetches_;
+  bool     idle_;
+  PerfStats perf_stats_;
+};
+
+}
@@ -15,17 +15,129 @@
 
 #define XLEN 32
 
-#define NUM_FUS 3
+#define NUM_FUS 5
 
 #define ALU_LATENCY 2
 #define LSU_LATENCY 100
 #define CSR_LATENCY 3
 
+#ifndef MUL_LATENCY
+#define MUL_LATENCY 4
+#endif
+
+#ifndef DIV_LATENCY
+#define DIV_LATENCY 20
+#endif
+
+// Functional unit instances and initiation intervals,
+// an interval of 1 is fully pipelined, the unit latency is blocking
+#ifndef ALU_UNITS
+#define ALU_UNITS 1
+#endif
+
+#ifndef ALU_INTERVAL
+#define ALU_INTERVAL 1
+#endif
+
+#ifndef LSU_UNITS
+#define LSU_UNITS 1
+#endif
+
+#ifndef LSU_INTERVAL
+#define LSU_INTERVAL 1
+#endif
+
+#ifndef CSR_UNITS
+#define CSR_UNITS 1
+#endif
+
+#ifndef CSR_INTERVAL
+#define CSR_INTERVAL 1
+#endif
+
+#ifndef MUL_UNITS
+#define MUL_UNITS 1
+#endif
+
+#ifndef MUL_INTERVAL
+#define MUL_INTERVAL 1
+#endif
+
+// the divider is iterative and blocks for the whole operation
+#ifndef DIV_UNITS
+#define DIV_UNITS 1
+#endif
+
+#ifndef DIV_INTERVAL
+#define DIV_INTERVAL DIV_LATENCY
+#endif
+
 #define CDB_LATENCY 2
 
+#ifndef NUM_RSS
 #define NUM_RSS 8
+#endif
 
+#ifndef ROB_SIZE
 #define ROB_SIZE 16
+#endif
+
+// Out-of-order pipeline widths, instructions per cycle
+#ifndef ISSUE_WIDTH
+#define ISSUE_WIDTH 1
+#endif
+
+#ifndef WRITEBACK_WIDTH
+#define WRITEBACK_WIDTH 1
+#endif
+
+#ifndef COMMIT_WIDTH
+#define COMMIT_WIDTH 1
+#endif
+
+// Issue ports per FU type for the age-ordered select (-a), 0 is unlimited,
+// one per unit by default so a selected operation never waits for a unit
+#ifndef ALU_ISSUE_PORTS
+#define ALU_ISSUE_PORTS ALU_UNITS
+#endif
+
+#ifndef LSU_ISSUE_PORTS
+#define LSU_ISSUE_PORTS LSU_UNITS
+#endif
+
+#ifndef CSR_ISSUE_PORTS
+#define CSR_ISSUE_PORTS CSR_UNITS
+#endif
+
+#ifndef MUL_ISSUE_PORTS
+#define MUL_ISSUE_PORTS MUL_UNITS
+#endif
+
+#ifndef DIV_ISSUE_PORTS
+#define DIV_ISSUE_PORTS DIV_UNITS
+#endif
+
+#ifndef LSQ_SIZE
+#define LSQ_SIZE 16
+#endif
+
+#ifndef LSQ_FORWARD_LATENCY
+#define LSQ_FORWARD_LATENCY 2
+#endif
+
+// flat issue stall after a memory order violation, nothing is re-executed
+#ifndef LSQ_REPLAY_PENALTY
+#define LSQ_REPLAY_PENALTY 16
+#endif
+
+// Store-set predictor tables (powers of two), SSIT_SIZE 0 disables it
+#ifndef SSIT_SIZE
+#define SSIT_SIZE 1024
+#endif
+
+#ifndef LFST_SIZE
+#define LFST_SIZE 128
+#endif
 
 #define NUM_REGS 32
 
@@ -76,6 +188,143 @@
 
 // Pipeline Configuration /////////////////////////////////////////////////////
 
+// Skip the cycles where every object is idle, 0 ticks every cycle
+#ifndef IDLE_SKIP
+#define IDLE_SKIP 1
+#endif
+
+// Emulator decoded instruction cache entries (power of two)
+#ifndef DECODE_CACHE_SIZE
+#define DECODE_CACHE_SIZE 4096
+#endif
+
+// Decoupled emulator trace queue entries (power of two)
+#ifndef TRACE_QUEUE_SIZE
+#define TRACE_QUEUE_SIZE 1024
+#endif
+
+// Emulator maximum instructions per translated basic block
+#ifndef BASIC_BLOCK_SIZE
+#define BASIC_BLOCK_SIZE 64
+#endif
+
+// Memory Hierarchy (enabled with -c) ////////////////////////////////////////
+
+#ifndef L1_LINE_SIZE
+#define L1_LINE_SIZE MEM_BLOCK_SIZE
+#endif
+
+// Replacement policies: 0 = LRU, 1 = pseudo-LRU
+#ifndef L1_REPL_POLICY
+#define L1_REPL_POLICY 0
+#endif
+
+#ifndef ICACHE_SIZE
+#define ICACHE_SIZE 16384
+#endif
+
+#ifndef ICACHE_NUM_WAYS
+#define ICACHE_NUM_WAYS 2
+#endif
+
+#ifndef ICACHE_LATENCY
+#define ICACHE_LATENCY 1
+#endif
+
+#ifndef ICACHE_MSHR_SIZE
+#define ICACHE_MSHR_SIZE 4
+#endif
+
+#ifndef DCACHE_SIZE
+#define DCACHE_SIZE 16384
+#endif
+
+#ifndef DCACHE_NUM_WAYS
+#define DCACHE_NUM_WAYS 4
+#endif
+
+#ifndef DCACHE_LATENCY
+#define DCACHE_LATENCY 2
+#endif
+
+#ifndef DCACHE_MSHR_SIZE
+#define DCACHE_MSHR_SIZE 16
+#endif
+
+// Prefetchers: 0 = none, 1 = next-line, 2 = stride, 3 = stream buffers
+#ifndef DCACHE_PREFETCHER
+#define DCACHE_PREFETCHER 0
+#endif
+
+#ifndef L2_PREFETCHER
+#define L2_PREFETCHER 0
+#endif
+
+// lines fetched ahead by the next-line and stride prefetchers
+#ifndef PREFETCH_DEGREE
+#define PREFETCH_DEGREE 2
+#endif
+
+// stride prefetcher PC-indexed table entries (power of two)
+#ifndef STRIDE_TABLE_SIZE
+#define STRIDE_TABLE_SIZE 64
+#endif
+
+#ifndef STREAM_BUFFERS
+#define STREAM_BUFFERS 4
+#endif
+
+#ifndef STREAM_DEPTH
+#define STREAM_DEPTH 4
+#endif
+
+#ifndef L2_SIZE
+#define L2_SIZE 131072
+#endif
+
+#ifndef L2_NUM_WAYS
+#define L2_NUM_WAYS 8
+#endif
+
+#ifndef L2_LATENCY
+#define L2_LATENCY 8
+#endif
+
+#ifndef L2_MSHR_SIZE
+#define L2_MSHR_SIZE 16
+#endif
+
+// DRAM banks are interleaved every MEM_BLOCK_SIZE bytes,
+// timings are in memory cycles of MEM_CYCLE_RATIO core cycles
+#ifndef DRAM_ROW_SIZE
+#define DRAM_ROW_SIZE 2048
+#endif
+
+#ifndef DRAM_QUEUE_SIZE
+#define DRAM_QUEUE_SIZE 16
+#endif
+
+#ifndef DRAM_TCAS
+#define DRAM_TCAS 14
+#endif
+
+#ifndef DRAM_TRCD
+#define DRAM_TRCD 14
+#endif
+
+#ifndef DRAM_TRP
+#define DRAM_TRP 14
+#endif
+
+#ifndef DRAM_TBURST
+#define DRAM_TBURST 4
+#endif
+
+// DRAM controller and interconnect latency in core cycles
+#ifndef DRAM_CTRL_LATENCY
+#define DRAM_CTRL_LATENCY 20
+#endif
+
 // Standard CSRs //////////////////////////////////////////////////////////////
 
 #define VX_CSR_SATP                     0x180
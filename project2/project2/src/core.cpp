@@ -28,6 +28,20 @@ using namespace tinyrv;
 
 extern bool gshare_enabled;
 extern bool ooo_enabled;
+extern bool caches_enabled;
+extern int dcache_prefetcher;
+extern uint32_t issue_width;
+extern uint32_t writeback_width;
+extern uint32_t commit_width;
+
+static Prefetcher* create_prefetcher(int type, uint32_t line_size) {
+  switch (type) {
+  case 1: return new NextLinePrefetcher(line_size, PREFETCH_DEGREE);
+  case 2: return new StridePrefetcher(line_size, STRIDE_TABLE_SIZE, PREFETCH_DEGREE);
+  case 3: return new StreamPrefetcher(line_size, STREAM_BUFFERS, STREAM_DEPTH);
+  default: return nullptr;
+  }
+}
 
 Core::Core(const SimContext& ctx, uint32_t core_id, ProcessorImpl* processor)
     : SimObject(ctx, "core")
@@ -35,17 +49,54 @@ Core::Core(const SimContext& ctx, uint32_t core_id, ProcessorImpl* processor)
     , processor_(processor)
     , emulator_(this)
 {
-  // create CPU pipeline
+  // create CPU pipeline, only the out-of-order core is superscalar
+  issue_width_ = 1;
+  writeback_width_ = 1;
+  commit_width_ = 1;
   if (ooo_enabled) {
-    pipeline_ = new Scoreboard(this, NUM_RSS, ROB_SIZE);
+    issue_width_ = issue_width;
+    writeback_width_ = writeback_width;
+    commit_width_ = commit_width;
+    pipeline_ = new Scoreboard(this, NUM_RSS, ROB_SIZE, commit_width_);
   } else {
     pipeline_ = new InorderPipeline(this);
   }
 
   // create functional units
-  FUs_[(int)FUType::ALU] = FunctionalUnit::Create(ALU_LATENCY);
-  FUs_[(int)FUType::LSU] = FunctionalUnit::Create(LSU_LATENCY);
-  FUs_[(int)FUType::CSR] = FunctionalUnit::Create(CSR_LATENCY);
+  FUs_[(int)FUType::ALU] = FunctionalUnit::Create("alu", FunctionalUnit::Config{ALU_UNITS, ALU_LATENCY, ALU_INTERVAL});
+  FUs_[(int)FUType::LSU] = FunctionalUnit::Create("lsu", FunctionalUnit::Config{LSU_UNITS, LSU_LATENCY, LSU_INTERVAL});
+  FUs_[(int)FUType::CSR] = FunctionalUnit::Create("csr", FunctionalUnit::Config{CSR_UNITS, CSR_LATENCY, CSR_INTERVAL});
+  FUs_[(int)FUType::MUL] = FunctionalUnit::Create("mul", FunctionalUnit::Config{MUL_UNITS, MUL_LATENCY, MUL_INTERVAL});
+  FUs_[(int)FUType::DIV] = FunctionalUnit::Create("div", FunctionalUnit::Config{DIV_UNITS, DIV_LATENCY, DIV_INTERVAL});
+
+  // create the memory hierarchy
+  if (caches_enabled) {
+    auto policy = (L1_REPL_POLICY == 1) ? CacheSim::PLRU : CacheSim::LRU;
+    icache_ = CacheSim::Create("icache", CacheSim::Config{
+      ICACHE_SIZE, ICACHE_NUM_WAYS, L1_LINE_SIZE, ICACHE_LATENCY, ICACHE_MSHR_SIZE, 1, true, policy});
+    dcache_ = CacheSim::Create("dcache", CacheSim::Config{
+      DCACHE_SIZE, DCACHE_NUM_WAYS, L1_LINE_SIZE, DCACHE_LATENCY, DCACHE_MSHR_SIZE, 1, true, policy});
+    l2cache_ = CacheSim::Create("l2cache", CacheSim::Config{
+      L2_SIZE, L2_NUM_WAYS, MEM_BLOCK_SIZE, L2_LATENCY, L2_MSHR_SIZE, 2, false, policy});
+    memsim_ = MemSim::Create(MemSim::Config{
+      1, MEMORY_BANKS, MEM_BLOCK_SIZE, DRAM_ROW_SIZE, DRAM_QUEUE_SIZE, MEM_CYCLE_RATIO,
+      DRAM_TCAS, DRAM_TRCD, DRAM_TRP, DRAM_TBURST, DRAM_CTRL_LATENCY});
+    dcache_->set_prefetcher(create_prefetcher(dcache_prefetcher, L1_LINE_SIZE));
+    l2cache_->set_prefetcher(create_prefetcher(L2_PREFETCHER, MEM_BLOCK_SIZE));
+
+    // the LSU accesses memory through the data cache
+    auto& lsu = FUs_[(int)FUType::LSU];
+    lsu->MemReqPort.bind(&dcache_->CoreReqPorts.at(0));
+    dcache_->CoreRspPorts.at(0).bind(&lsu->MemRspPort);
+
+    // both L1 caches share the L2 in front of main memory
+    icache_->MemReqPort.bind(&l2cache_->CoreReqPorts.at(0));
+    l2cache_->CoreRspPorts.at(0).bind(&icache_->MemRspPort);
+    dcache_->MemReqPort.bind(&l2cache_->CoreReqPorts.at(1));
+    l2cache_->CoreRspPorts.at(1).bind(&dcache_->MemRspPort);
+    l2cache_->MemReqPort.bind(&memsim_->MemReqPorts.at(0));
+    memsim_->MemRspPorts.at(0).bind(&l2cache_->MemRspPort);
+  }
 
   this->reset();
 }
@@ -57,61 +108,121 @@ Core::~Core() {
 void Core::reset() { 
   emulator_.clear();
   stalled_trace_ = nullptr;
+  fetch_pending_ = false;
+  fetch_line_ = ~uint64_t(0);
   branch_stalls_ = 0;
   fetched_instrs_ = 0;
+  idle_ = false;
   perf_stats_ = PerfStats();
 }
 
 void Core::tick() {
-  this->commit();
-  this->writeback();
-  this->execute();
-  this->issue();
+  bool progress = false;
+  progress |= this->commit();
+  progress |= this->writeback();
+  progress |= this->execute();
+  progress |= this->issue();
+  // a replay penalty counts down every cycle
+  idle_ = !progress && !pipeline_->busy();
 
   pipeline_->dump();
   ++perf_stats_.cycles;
   DPN(2, std::flush);  
 }
 
-void Core::issue() {
+bool Core::idle() const {
+#if (!defined(NDEBUG) && (DEBUG_LEVEL >= 3)) || !IDLE_SKIP
+  // keep the per-cycle stall traces
+  return false;
+#else
+  return idle_;
+#endif
+}
+
+void Core::skip(uint64_t cycles) {
+  perf_stats_.cycles += cycles;
+  pipeline_->skip(cycles);
+}
+
+bool Core::issue() {
+  // fetch and issue in order until a slot stalls,
+  // extra slots stop fetching once the program has exited
+  bool progress = false;
+  for (uint32_t i = 0; i < issue_width_; ++i) {
+    if (i != 0 && stalled_trace_ == nullptr && emulator_.has_exited())
+      break;
+    bool issued = false;
+    progress |= this->issue_one(&issued);
+    if (!issued)
+      break;
+  }
+  return progress;
+}
+
+bool Core::issue_one(bool* issued) {
   auto trace = stalled_trace_;
   if (branch_stalls_ != 0) {
     --branch_stalls_;
     DT(3, "*** branch stalled!: " << *trace);
-    return;
+    return true;
   }
 
-  if (trace == nullptr) {
+  bool fetched = false;
+  if (fetch_pending_) {
+    // wait for the instruction cache
+    if (icache_->CoreRspPorts.at(0).empty())
+      return false;
+    icache_->CoreRspPorts.at(0).pop();
+    fetch_pending_ = false;
+    fetched = true;
+  } else if (trace == nullptr) {
+    fetched = true;
     trace = emulator_.step();
     stalled_trace_ = trace;
     ++fetched_instrs_;
+    if (icache_) {
+      // access the instruction cache when leaving the current fetch line
+      auto line = icache_->line_addr(trace->PC);
+      if (line != fetch_line_) {
+        fetch_line_ = line;
+        fetch_pending_ = true;
+        icache_->CoreReqPorts.at(0).send(MemReq{trace->PC, false, 0, trace->uuid, trace->PC}, 1);
+        return true;
+      }
+    }
+  }
+
+  if (fetched) {
     if (trace->fu_type == FUType::ALU 
      && trace->alu_op == AluOp::BRANCH) {
       if (gshare_enabled) {
         if (!gshare_.predict(trace)) {
           DT(3, "*** branch stalled!: " << *trace);
           branch_stalls_ = 2;
-          return;
+          return true;
         }
       } else {        
         DT(3, "*** branch stalled!: " << *trace);
         branch_stalls_ = 2;
-        return;
+        return true;
       }
     }
   }
 
   if (!pipeline_->issue(trace)) {
     DT(3, "*** issue stalled!: " << *trace);
-    return;
+    // a newly fetched trace still counts as progress
+    return fetched;
   }
 
   DT(3, "pipeline-issue: " << *trace);
 
   stalled_trace_ = nullptr;  
+  *issued = true;
+  return true;
 }
 
-void Core::execute() {   
+bool Core::execute() {   
   auto traces = pipeline_->execute();
   
   for (auto trace : traces) {
@@ -120,30 +231,44 @@ void Core::execute() {
     // std::cout <<"nested looppppppppp";
   }
   // std::cout<<"infinite loop  core execute \n";
+  return !traces.empty();
 }
 
-void Core::writeback() {
-  auto trace = pipeline_->writeback();
-  if (trace) {
-    __unused (trace);
+bool Core::writeback() {
+  bool progress = false;
+  for (uint32_t i = 0; i < writeback_width_; ++i) {
+    auto trace = pipeline_->writeback();
+    if (trace == nullptr)
+      break;
     DT(3, "pipeline-writeback: " << *trace);
+    progress = true;
   }
+  return progress;
 }
 
-void Core::commit() {
-  auto trace = pipeline_->commit();
-  if (trace) {  
+bool Core::commit() {
+  bool progress = false;
+  for (uint32_t i = 0; i < commit_width_; ++i) {
+    auto trace = pipeline_->commit();
+    if (trace == nullptr)
+      break;
     DT(3, "pipeline-commit: " << *trace);
     assert(perf_stats_.instrs <= fetched_instrs_);
     ++perf_stats_.instrs;
     delete trace;
+    progress = true;
   }
+  return progress;
 }
 
 bool Core::check_exit(Word* exitcode, bool riscv_test) const {
   return emulator_.check_exit(exitcode, riscv_test);
 }
 
+void Core::fast_forward(uint64_t instrs) {
+  emulator_.run_functional(instrs);
+}
+
 bool Core::running() const {
   return (perf_stats_.instrs != fetched_instrs_) || (fetched_instrs_ == 0);
 }
@@ -152,6 +277,68 @@ void Core::attach_ram(RAM* ram) {
   emulator_.attach_ram(ram);
 }
 
+static uint64_t calc_ratio(uint64_t count, uint64_t total) {
+  return (total != 0) ? (count * 100 / total) : 0;
+}
+
+static void show_prefetch_stats(const char* name, const CacheSim::Ptr& cache) {
+  if (cache->prefetcher() == nullptr)
+    return;
+  auto& stats = cache->perf_stats();
+  // late prefetches still saved part of the miss latency
+  auto covered = stats.pf_useful + stats.pf_late;
+  auto misses = stats.read_misses + stats.write_misses - stats.pf_late;
+  std::cout << std::dec << "PERF: " << name << " " << cache->prefetcher()->name() << " prefetches=" << stats.pf_issued 
+            << ", useful=" << stats.pf_useful << ", late=" << stats.pf_late << ", unused=" << stats.pf_unused 
+            << ", dropped=" << stats.pf_dropped << " (accuracy=" << calc_ratio(covered, stats.pf_issued) 
+            << "%, coverage=" << calc_ratio(covered, covered + misses) 
+            << "%, timeliness=" << calc_ratio(stats.pf_useful, covered) << "%)" << std::endl;
+}
+
 void Core::showStats() {
   std::cout << std::dec << "PERF: instrs=" << perf_stats_.instrs << ", cycles=" << perf_stats_.cycles << std::endl;
+  if (icache_) {
+    auto& icache = icache_->perf_stats();
+    auto& dcache = dcache_->perf_stats();
+    auto icache_hit_ratio = calc_ratio(icache.reads - icache.read_misses, icache.reads);
+    auto dcache_accesses = dcache.reads + dcache.writes;
+    auto dcache_hit_ratio = calc_ratio(dcache_accesses - dcache.read_misses - dcache.write_misses, dcache_accesses);
+    std::cout << std::dec << "PERF: icache reads=" << icache.reads << ", misses=" << icache.read_misses 
+              << " (hit ratio=" << icache_hit_ratio << "%)" << std::endl;
+    std::cout << std::dec << "PERF: dcache reads=" << dcache.reads << ", writes=" << dcache.writes 
+              << ", read misses=" << dcache.read_misses << ", write misses=" << dcache.write_misses 
+              << ", writebacks=" << dcache.writebacks << " (hit ratio=" << dcache_hit_ratio << "%)" << std::endl;
+    std::cout << std::dec << "PERF: dcache mshr merges=" << dcache.mshr_merges << ", mshr stalls=" << dcache.mshr_stalls 
+              << ", hits under miss=" << dcache.hits_under_miss << std::endl;
+    show_prefetch_stats("dcache", dcache_);
+    auto& l2cache = l2cache_->perf_stats();
+    auto l2cache_accesses = l2cache.reads + l2cache.writes;
+    auto l2cache_hit_ratio = calc_ratio(l2cache_accesses - l2cache.read_misses - l2cache.write_misses, l2cache_accesses);
+    std::cout << std::dec << "PERF: l2cache reads=" << l2cache.reads << ", writes=" << l2cache.writes 
+              << ", read misses=" << l2cache.read_misses << ", write misses=" << l2cache.write_misses 
+              << ", writebacks=" << l2cache.writebacks << " (hit ratio=" << l2cache_hit_ratio << "%)" << std::endl;
+    show_prefetch_stats("l2cache", l2cache_);
+    auto& mem = memsim_->perf_stats();
+    auto row_accesses = mem.row_hits + mem.row_misses + mem.row_conflicts;
+    auto mem_read_latency = (mem.reads != 0) ? (mem.read_latency / mem.reads) : 0;
+    std::cout << std::dec << "PERF: memory reads=" << mem.reads << ", writes=" << mem.writes 
+              << ", row hits=" << mem.row_hits << ", row misses=" << mem.row_misses 
+              << ", row conflicts=" << mem.row_conflicts << " (row hit ratio=" << calc_ratio(mem.row_hits, row_accesses) << "%)" 
+              << ", queue stalls=" << mem.queue_stalls << ", avg read latency=" << mem_read_latency << std::endl;
+    for (uint32_t i = 0; i < mem.bank_busy.size(); ++i) {
+      std::cout << std::dec << "PERF: memory bank" << i << " busy cycles=" << mem.bank_busy.at(i) 
+                << " (utilization=" << calc_ratio(mem.bank_busy.at(i), perf_stats_.cycles) << "%)" << std::endl;
+    }
+  }
+  for (auto& fu : FUs_) {
+    auto& config = fu->config();
+    auto& stats = fu->perf_stats();
+    std::cout << std::dec << "PERF: " << fu->name() << " units=" << config.num_units << ", ops=" << stats.ops 
+              << ", busy cycles=" << stats.busy_cycles << ", stalls=" << stats.stalls 
+              << " (utilization=" << calc_ratio(stats.busy_cycles, perf_stats_.cycles * config.num_units) << "%)" << std::endl;
+  }
+  pipeline_->showStats();
+  if (perf_stats_.ff_instrs != 0) {
+    std::cout << std::dec << "PERF: fast-forwarded instrs=" << perf_stats_.ff_instrs << std::endl;
+  }
 }
\ No newline at end of file
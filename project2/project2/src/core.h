@@ -21,12 +21,15 @@
 #include <unordered_map>
 #include <memory>
 #include <set>
+#include <array>
 #include <simobject.h>
 #include "debug.h"
 #include "types.h"
 #include "emulator.h"
 #include "FU.h"
 #include "gshare.h"
+#include "cache.h"
+#include "memsim.h"
 
 namespace tinyrv {
 
@@ -40,10 +43,12 @@ public:
   struct PerfStats {
     uint64_t cycles;
     uint64_t instrs;
+    uint64_t ff_instrs;
 
     PerfStats() 
       : cycles(0)
       , instrs(0)
+      , ff_instrs(0)
     {}
   };
 
@@ -54,32 +59,50 @@ public:
 
   void tick();
 
+  bool idle() const;
+
+  void skip(uint64_t cycles);
+
   void attach_ram(RAM* ram);
 
   bool running() const;
 
   bool check_exit(Word* exitcode, bool riscv_test) const;
 
+  void fast_forward(uint64_t instrs);
+
   void showStats();
 
 private:
 
-  void issue();
-  void execute();
-  void writeback();
-  void commit();
+  bool issue();
+  bool issue_one(bool* issued);
+  bool execute();
+  bool writeback();
+  bool commit();
 
   uint32_t core_id_;
   ProcessorImpl* processor_;
   Emulator emulator_;
 
   std::array<FunctionalUnit::Ptr, NUM_FUS> FUs_;
+  CacheSim::Ptr icache_;
+  CacheSim::Ptr dcache_;
+  CacheSim::Ptr l2cache_;
+  MemSim::Ptr memsim_;
   Pipeline* pipeline_;
   GShare gshare_;
 
+  uint32_t issue_width_;
+  uint32_t writeback_width_;
+  uint32_t commit_width_;
+
   int branch_stalls_;
   pipeline_trace_t* stalled_trace_;
+  bool fetch_pending_;
+  uint64_t fetch_line_;
   uint64_t fetched_instrs_;
+  bool idle_;
 
   PerfStats perf_stats_;
 
@@ -203,8 +203,8 @@ std::ostream &operator<<(std::ostream &os, const Instr &instr) {
 
 }
 
-std::shared_ptr<Instr> Emulator::decode(uint32_t code) const {  
-  auto instr = std::make_shared<Instr>();
+bool Emulator::decode(uint32_t code, Instr* instr) const {  
+  *instr = Instr();
   auto op = Opcode((code >> shift_opcode) & mask_opcode);
   instr->setOpcode(op);
 
@@ -218,7 +218,7 @@ std::shared_ptr<Instr> Emulator::decode(uint32_t code) const {
   auto op_it = sc_instTable.find(op);
   if (op_it == sc_instTable.end()) {
     std::cout << std::hex << "Error: invalid opcode: 0x" << static_cast<int>(op) << std::endl;
-    return nullptr;
+    return false;
   }
 
   auto iType = op_it->second;
@@ -325,5 +325,5 @@ std::shared_ptr<Instr> Emulator::decode(uint32_t code) const {
     std::abort();
   }
 
-  return instr;
+  return true;
 }
\ No newline at end of file
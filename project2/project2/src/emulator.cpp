@@ -23,35 +23,177 @@
 #include "types.h"
 #include "emulator.h"
 #include "trace.h"
+#include "tracefile.h"
 #include "instr.h"
 #include "core.h"
 
 using namespace tinyrv;
 
+extern bool decoupled_enabled;
+extern const char* trace_record_file;
+extern const char* trace_replay_file;
+extern uint64_t startup_addr;
+extern uint64_t tohost_addr;
+
 Emulator::Emulator(Core* core) 
   : core_(core)
-  , reg_file_(NUM_REGS) {
+  , reg_file_(NUM_REGS)
+  , decode_cache_(DECODE_CACHE_SIZE)
+  , code_pages_(uint64_t(1) << (32 - log2ceil(RAM_PAGE_SIZE)))
+  , blocks_dirty_(false)
+  , decoupled_(decoupled_enabled && !trace_replay_file)
+  , trace_queue_(TRACE_QUEUE_SIZE)
+  , producer_stop_(false)
+  , producer_done_(false)
+  , sync_request_(false)
+  , consumed_exit_(false)
+  , replay_uuid_(1) {
+    static_assert(ispow2(DECODE_CACHE_SIZE), "invalid size");
+    if (trace_replay_file) {
+      trace_reader_.reset(new TraceReader(trace_replay_file));
+    }
     this->clear();
 }
 
 Emulator::~Emulator() {
+  this->stop_producer();
   this->cout_flush();
 }
 
 void Emulator::clear() {
-  PC_ = STARTUP_ADDR;
+  this->stop_producer();
+  PC_ = startup_addr;
   csrs_.clear();
   cout_buf_.clear();
   uui_gen_.reset();
   perf_stats_ = PerfStats();  
   exited_ = false;
+  tohost_addr_ = tohost_addr;
+  tohost_exit_ = false;
+  tohost_code_ = 0;
+  if (trace_reader_) {
+    trace_reader_->rewind();
+    replay_uuid_ = 1;
+  }
+  if (trace_record_file) {
+    trace_writer_.reset(new TraceWriter(trace_record_file));
+  }
+  this->flush_decoded();
+  this->flush_blocks();
 }
 
 void Emulator::attach_ram(RAM* ram) {
   mmu_.attach(*ram, 0, 0xFFFFFFFF);
+  this->flush_decoded();
+  this->flush_blocks();
 }
 
 pipeline_trace_t* Emulator::step() {
+  auto trace = this->fetch_trace();
+  if (trace_writer_) {
+    trace_writer_->write(*trace);
+    if (this->has_exited()) {
+      trace_writer_->close(tohost_exit_ ? tohost_code_ : reg_file_.at(3), tohost_exit_);
+    }
+  }
+  return trace;
+}
+
+pipeline_trace_t* Emulator::fetch_trace() {
+  if (trace_reader_) {
+    auto trace = trace_reader_->read(replay_uuid_++);
+    if (trace == nullptr) {
+      std::cout << "Error: instruction trace exhausted" << std::endl;
+      std::abort();
+    }
+    return trace;
+  }
+  if (decoupled_)
+    return this->consume_trace();
+  return this->execute_next();
+}
+
+pipeline_trace_t* Emulator::consume_trace() {
+  if (!producer_.joinable()) {
+    this->start_producer();
+  }
+  trace_record_t record;
+  for (;;) {
+    if (trace_queue_.try_pop(&record))
+      break;
+    if (sync_request_.load(std::memory_order_acquire)
+     || producer_done_.load(std::memory_order_acquire)) {
+      // the queue content is final once the producer is waiting
+      if (trace_queue_.try_pop(&record))
+        break;
+      // execute the instruction on the core thread
+      auto trace = this->execute_next();
+      consumed_exit_ = exited_;
+      sync_request_.store(false, std::memory_order_release);
+      return trace;
+    }
+    std::this_thread::yield();
+  }
+  consumed_exit_ = record.exited;
+  return record.trace;
+}
+
+void Emulator::producer_loop() {
+  while (!producer_stop_.load(std::memory_order_acquire)) {
+    // CSR accesses observe the timing model, 
+    // hand them over to the core thread once all older traces are consumed
+    auto& decoded = this->fetch_decoded();
+    if (decoded.valid
+     && decoded.instr.getOpcode() == Opcode::SYS 
+     && decoded.instr.getFunc3() != 0) {
+      sync_request_.store(true, std::memory_order_release);
+      while (sync_request_.load(std::memory_order_acquire)) {
+        if (producer_stop_.load(std::memory_order_acquire))
+          return;
+        std::this_thread::yield();
+      }
+      continue;
+    }
+
+    auto trace = this->execute_next();
+    trace_record_t record{trace, exited_};
+    while (!trace_queue_.try_push(record)) {
+      if (producer_stop_.load(std::memory_order_acquire)) {
+        delete trace;
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    if (exited_)
+      break;
+  }
+  producer_done_.store(true, std::memory_order_release);
+}
+
+void Emulator::start_producer() {
+  trace_queue_.clear();
+  producer_stop_ = false;
+  producer_done_ = exited_;
+  sync_request_ = false;
+  consumed_exit_ = false;
+  if (!exited_) {
+    producer_ = std::thread(&Emulator::producer_loop, this);
+  }
+}
+
+void Emulator::stop_producer() {
+  if (!producer_.joinable())
+    return;
+  producer_stop_ = true;
+  producer_.join();
+  trace_record_t record;
+  while (trace_queue_.try_pop(&record)) {
+    delete record.trace;
+  }
+}
+
+pipeline_trace_t* Emulator::execute_next() {
 #ifndef NDEBUG
   uint32_t uuid = uui_gen_.get_uuid(PC_);
 #else
@@ -60,24 +202,20 @@ pipeline_trace_t* Emulator::step() {
   
   DPH(1, "Fetch: PC=0x" << std::hex << PC_ << " (#" << std::dec << uuid << ")" << std::endl);
 
-  // fetch
-  uint32_t instr_code = 0;
-  this->icache_read(&instr_code, PC_, sizeof(uint32_t));
-
-  // decode
-  auto instr = this->decode(instr_code);
-  if (!instr) {
-    std::cout << std::hex << "Error: invalid instruction 0x" << instr_code << ", at PC=0x" << PC_ << " (#" << std::dec << uuid << ")" << std::endl;
+  // fetch and decode
+  auto& decoded = this->fetch_decoded();
+  if (!decoded.valid) {
+    std::cout << std::hex << "Error: invalid instruction 0x" << decoded.code << ", at PC=0x" << PC_ << " (#" << std::dec << uuid << ")" << std::endl;
     std::abort();
   }  
 
-  DP(1, "Instr 0x" << std::hex << instr_code << ": " << *instr);
+  DP(1, "Instr 0x" << std::hex << decoded.code << ": " << decoded.instr);
 
   // create a new instruction trace
   auto trace = new pipeline_trace_t(uuid, PC_);
     
   // execute
-  this->execute(*instr, trace);
+  this->execute(decoded.instr, trace);
 
   DP(5, "Register File:");
   for (uint32_t i = 0; i < NUM_REGS; ++i) {
@@ -88,6 +226,36 @@ pipeline_trace_t* Emulator::step() {
   return trace;
 }
 
+const Emulator::decoded_instr_t& Emulator::fetch_decoded() {
+  auto& entry = decode_cache_[(PC_ >> 2) & (DECODE_CACHE_SIZE - 1)];
+  if (entry.valid && entry.PC == PC_)
+    return entry;
+  
+  // miss: fetch from memory and decode
+  uint32_t instr_code = 0;
+  this->icache_read(&instr_code, PC_, sizeof(uint32_t));
+  entry.PC = PC_;
+  entry.code = instr_code;
+  entry.valid = this->decode(instr_code, &entry.instr);
+  return entry;
+}
+
+void Emulator::invalidate_decoded(uint64_t addr, uint32_t size) {
+  // drop the cached words overlapping the written bytes
+  for (uint64_t a = (addr & ~uint64_t(3)), end = addr + size; a < end; a += 4) {
+    auto& entry = decode_cache_[(a >> 2) & (DECODE_CACHE_SIZE - 1)];
+    if (entry.PC == a) {
+      entry.valid = false;
+    }
+  }
+}
+
+void Emulator::flush_decoded() {
+  for (auto& entry : decode_cache_) {
+    entry.valid = false;
+  }
+}
+
 void Emulator::trigger_ecall() {
   exited_ = true;
 }
@@ -96,10 +264,27 @@ void Emulator::trigger_ebreak() {
   exited_ = true;
 }
 
+bool Emulator::has_exited() const {
+  if (trace_reader_)
+    return trace_reader_->exited();
+  // in decoupled mode, only report the exit once its trace was consumed
+  return producer_.joinable() ? consumed_exit_ : exited_;
+}
+
 bool Emulator::check_exit(Word* exitcode, bool riscv_test) const {
-  if (exited_) {
-    Word ec = reg_file_.at(3);
-    if (riscv_test) {
+  if (this->has_exited()) {
+    Word ec;
+    bool direct;
+    if (trace_reader_) {
+      ec = trace_reader_->exitcode();
+      direct = trace_reader_->exit_direct();
+    } else {
+      direct = tohost_exit_;
+      ec = direct ? tohost_code_ : reg_file_.at(3);
+    }
+    if (direct) {
+      *exitcode = ec;
+    } else if (riscv_test) {
       *exitcode = (1 - ec);
     } else {
       *exitcode = ec;
@@ -127,7 +312,22 @@ void Emulator::dcache_write(const void* data, uint64_t addr, uint32_t size) {
    && addr < (uint64_t(IO_COUT_ADDR) + IO_COUT_SIZE)) {
      this->writeToStdOut(data);
   } else {
+    if (addr == tohost_addr_ && tohost_addr_ != 0) {
+      // HTIF exit request: tohost = (exitcode << 1) | 1
+      Word value = 0;
+      memcpy(&value, data, std::min<uint32_t>(size, sizeof(Word)));
+      if (value & 1) {
+        tohost_code_ = value >> 1;
+        tohost_exit_ = true;
+        exited_ = true;
+      }
+    }
     mmu_.write(data, addr, size, 0);
+    this->invalidate_decoded(addr, size);
+    if (code_pages_[(addr >> log2ceil(RAM_PAGE_SIZE)) & (code_pages_.size() - 1)]) {
+      // translated code was modified
+      blocks_dirty_ = true;
+    }
   }
   DPH(2, "Mem Write: addr=0x" << std::hex << addr << ", data=0x" << ByteStream(data, size) << " (size=" << size << ", type=" << type << ")" << std::endl);  
 }
@@ -164,13 +364,13 @@ uint32_t Emulator::get_csr(uint32_t addr) {
   case VX_CSR_MNSTATUS:
     return 0;    
   case VX_CSR_MCYCLE: // NumCycles
-    return core_->perf_stats_.cycles & 0xffffffff;
+    return (core_->perf_stats_.cycles + core_->perf_stats_.ff_instrs) & 0xffffffff;
   case VX_CSR_MCYCLE_H: // NumCycles
-    return (uint32_t)(core_->perf_stats_.cycles >> 32);
+    return (uint32_t)((core_->perf_stats_.cycles + core_->perf_stats_.ff_instrs) >> 32);
   case VX_CSR_MINSTRET: // NumInsts
-    return core_->perf_stats_.instrs & 0xffffffff;
+    return (core_->perf_stats_.instrs + core_->perf_stats_.ff_instrs) & 0xffffffff;
   case VX_CSR_MINSTRET_H: // NumInsts
-    return (uint32_t)(core_->perf_stats_.instrs >> 32);
+    return (uint32_t)((core_->perf_stats_.instrs + core_->perf_stats_.ff_instrs) >> 32);
   default:
     std::cout << std::hex << "Error: invalid CSR read addr=0x" << addr << std::endl;
     std::abort();
@@ -16,12 +16,17 @@
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
 #include <mem.h>
+#include <ringbuffer.h>
 #include "types.h"
+#include "instr.h"
+#include "tracefile.h"
 
 namespace tinyrv {
 
-class Instr;
 class pipeline_trace_t;
 class Core;
 
@@ -45,14 +50,79 @@ public:
 
   void attach_ram(RAM* ram);
 
+  // return the next instruction trace
+  // in decoupled mode, traces are produced ahead on a separate thread
   pipeline_trace_t* step();
 
+  // execute up to max_instrs instructions without generating traces
+  uint64_t run_functional(uint64_t max_instrs);
+
   bool check_exit(Word* exitcode, bool riscv_test) const;
 
+  // the program has executed its exit
+  bool has_exited() const;
+
 private:
 
-  std::shared_ptr<Instr> decode(uint32_t code) const;
+  struct trace_record_t {
+    pipeline_trace_t* trace;
+    bool exited;
+  };
+
+  pipeline_trace_t* execute_next();
+
+  pipeline_trace_t* fetch_trace();
+
+  pipeline_trace_t* consume_trace();
+
+  void producer_loop();
+
+  void start_producer();
+
+  void stop_producer();
+
+  struct decoded_instr_t {
+    bool     valid;
+    Word     PC;
+    uint32_t code;
+    Instr    instr;
+  };
+
+  bool decode(uint32_t code, Instr* instr) const;
+
+  const decoded_instr_t& fetch_decoded();
 
+  void invalidate_decoded(uint64_t addr, uint32_t size);
+
+  void flush_decoded();
+
+  struct bb_op_t;
+
+  // block handlers return false when they redirect the PC
+  typedef bool (*bb_handler_t)(Emulator* emu, const bb_op_t& op);
+
+  struct bb_op_t {
+    bb_handler_t handler;
+    Word     PC;
+    uint32_t rd;
+    uint32_t rs1;
+    uint32_t rs2;
+    Word     imm;
+  };
+
+  struct basic_block_t {
+    Word PC;
+    Word end_PC;
+    std::vector<bb_op_t> ops;
+    // chained successors: fall-through and redirected PC
+    basic_block_t* next[2];
+  };
+
+  basic_block_t* lookup_block(Word PC);
+
+  bool translate(const Instr& instr, bb_op_t* op);
+
+  void flush_blocks();
   pipeline_trace_t* execute(const Instr &instr);
 
   void execute(const Instr &instr, pipeline_trace_t *trace);
@@ -81,12 +151,33 @@ private:
   MemoryUnit mmu_;
   CSRs csrs_;
   Word PC_;
+
+  std::vector<decoded_instr_t> decode_cache_;
+
+  std::unordered_map<Word, std::unique_ptr<basic_block_t>> blocks_;
+  std::vector<bool> code_pages_;
+  bool blocks_dirty_;
   
   std::stringstream cout_buf_;
   
   UUIDGenerator uui_gen_;
 
   bool exited_;
+  uint64_t tohost_addr_;
+  bool tohost_exit_;
+  Word tohost_code_;
+
+  bool decoupled_;
+  RingBuffer<trace_record_t> trace_queue_;
+  std::thread producer_;
+  std::atomic<bool> producer_stop_;
+  std::atomic<bool> producer_done_;
+  std::atomic<bool> sync_request_;
+  bool consumed_exit_;
+
+  std::unique_ptr<TraceWriter> trace_writer_;
+  std::unique_ptr<TraceReader> trace_reader_;
+  uint64_t replay_uuid_;
 
   PerfStats perf_stats_;
 };
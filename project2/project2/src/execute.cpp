@@ -100,6 +100,114 @@ void Emulator::execute(const Instr &instr, pipeline_trace_t *trace)
     trace->alu_op = AluOp::ARITH;
     trace->rs1 = rs1;
     trace->rs2 = rs2;
+    if (func7 & 0x1)
+    {
+      // RV32M: multiplies and divides run on their own units
+      trace->fu_type = (func3 < 4) ? FUType::MUL : FUType::DIV;
+      trace->alu_op = (func3 < 4) ? AluOp::IMUL : AluOp::IDIV;
+      switch (func3)
+      {
+      case 0:
+      {
+        // RV32M: MUL
+        rddata.u = rsdata[0].u * rsdata[1].u;
+        break;
+      }
+      case 1:
+      {
+        // RV32M: MULH
+        int64_t result = int64_t(rsdata[0].i32) * int64_t(rsdata[1].i32);
+        rddata.i = result >> 32;
+        break;
+      }
+      case 2:
+      {
+        // RV32M: MULHSU
+        int64_t result = int64_t(rsdata[0].i32) * int64_t(rsdata[1].u32);
+        rddata.i = result >> 32;
+        break;
+      }
+      case 3:
+      {
+        // RV32M: MULHU
+        uint64_t result = uint64_t(rsdata[0].u32) * uint64_t(rsdata[1].u32);
+        rddata.i = result >> 32;
+        break;
+      }
+      case 4:
+      {
+        // RV32M: DIV
+        WordI dividend = rsdata[0].i32;
+        WordI divisor = rsdata[1].i32;
+        if (divisor == 0)
+        {
+          rddata.i = -1;
+        }
+        else if (dividend == INT_MIN && divisor == -1)
+        {
+          rddata.i = dividend;
+        }
+        else
+        {
+          rddata.i = dividend / divisor;
+        }
+        break;
+      }
+      case 5:
+      {
+        // RV32M: DIVU
+        Word dividend = rsdata[0].u32;
+        Word divisor = rsdata[1].u32;
+        if (divisor == 0)
+        {
+          rddata.i = -1;
+        }
+        else
+        {
+          rddata.i = dividend / divisor;
+        }
+        break;
+      }
+      case 6:
+      {
+        // RV32M: REM
+        WordI dividend = rsdata[0].i32;
+        WordI divisor = rsdata[1].i32;
+        if (divisor == 0)
+        {
+          rddata.i = dividend;
+        }
+        else if (dividend == INT_MIN && divisor == -1)
+        {
+          rddata.i = 0;
+        }
+        else
+        {
+          rddata.i = dividend % divisor;
+        }
+        break;
+      }
+      case 7:
+      {
+        // RV32M: REMU
+        Word dividend = rsdata[0].u32;
+        Word divisor = rsdata[1].u32;
+        if (divisor == 0)
+        {
+          rddata.i = dividend;
+        }
+        else
+        {
+          rddata.i = dividend % divisor;
+        }
+        break;
+      }
+      default:
+        std::abort();
+      }
+      rd_write = true;
+      break;
+    }
     switch (func3)
     {
     case 0:
@@ -501,6 +609,11 @@ void Emulator::execute(const Instr &instr, pipeline_trace_t *trace)
     // RV32I: FENCE
     trace->fu_type = FUType::LSU;
     trace->slu_op = LsuOp::FENCE;
+    if (func3 == 1) {
+      // RV32I: FENCE.I
+      this->flush_decoded();
+      blocks_dirty_ = true;
+    }
     break;
   }
   default:
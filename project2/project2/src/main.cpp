@@ -17,6 +17,7 @@
 #include <sstream>
 #include <fstream>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <util.h>
@@ -27,17 +28,30 @@
 using namespace tinyrv;
 
 static void show_usage() {
-   std::cout << "Usage: [-g: gshare] [-o: ooo] [-s: stats] [-h: help] <program>" << std::endl;
+   std::cout << "Usage: [-g: gshare] [-o: ooo] [-l: load/store queue (with -o)] [-n <width>: superscalar width (with -o)] [-a: age-ordered select with issue ports (with -o)] [-c: caches] [-p <none|nextline|stride|stream>: dcache prefetcher] [-d: decoupled emulator] [-w <file>: record trace] [-r <file>: replay trace] [-f <n>: fast-forward n instructions] [-s: stats] [-h: help] <program>" << std::endl;
 }
 
 bool showStats = false;
 const char* program = nullptr;
 bool gshare_enabled = false;
 bool ooo_enabled = false;
+bool lsq_enabled = false;
+bool age_select_enabled = false;
+uint32_t issue_width = ISSUE_WIDTH;
+uint32_t writeback_width = WRITEBACK_WIDTH;
+uint32_t commit_width = COMMIT_WIDTH;
+bool caches_enabled = false;
+int dcache_prefetcher = DCACHE_PREFETCHER;
+bool decoupled_enabled = false;
+uint64_t fastforward_instrs = 0;
+uint64_t startup_addr = STARTUP_ADDR;
+uint64_t tohost_addr = 0;
+const char* trace_record_file = nullptr;
+const char* trace_replay_file = nullptr;
 
 static void parse_args(int argc, char **argv) {
   	int c;
-  	while ((c = getopt(argc, argv, "ogsh?")) != -1) {
+  	while ((c = getopt(argc, argv, "oglacdsn:p:f:w:r:h?")) != -1) {
     	switch (c) {
       case 's':
         showStats = true;
@@ -48,6 +62,49 @@ static void parse_args(int argc, char **argv) {
       case 'g':
         gshare_enabled = true;
         break;
+      case 'l':
+        lsq_enabled = true;
+        break;
+      case 'a':
+        age_select_enabled = true;
+        break;
+      case 'n': {
+        uint32_t width = strtoul(optarg, nullptr, 0);
+        if (width == 0) {
+          show_usage();
+          exit(-1);
+        }
+        issue_width = width;
+        writeback_width = width;
+        commit_width = width;
+      } break;
+      case 'c':
+        caches_enabled = true;
+        break;
+      case 'd':
+        decoupled_enabled = true;
+        break;
+      case 'p': {
+        static const char* const names[] = {"none", "nextline", "stride", "stream"};
+        dcache_prefetcher = -1;
+        for (int i = 0; i < 4; ++i) {
+          if (strcmp(optarg, names[i]) == 0)
+            dcache_prefetcher = i;
+        }
+        if (dcache_prefetcher < 0) {
+          show_usage();
+          exit(-1);
+        }
+      } break;
+      case 'f':
+        fastforward_instrs = strtoull(optarg, nullptr, 0);
+        break;
+      case 'w':
+        trace_record_file = optarg;
+        break;
+      case 'r':
+        trace_replay_file = optarg;
+        break;
       case 'h':
     	case '?':
       		show_usage();
@@ -62,7 +119,9 @@ static void parse_args(int argc, char **argv) {
 	if (optind < argc) {
 		program = argv[optind];
     std::cout << "Running " << program << ".." << std::endl;
-	} else {
+	} else if (trace_replay_file) {
+    std::cout << "Replaying " << trace_replay_file << ".." << std::endl;
+  } else {
 		show_usage();
     exit(-1);
 	}
@@ -77,15 +136,17 @@ int main(int argc, char **argv) {
     // create memory module
     RAM ram(RAM_PAGE_SIZE);
 
-    // load program
-    {      
+    // load program, a replayed trace does not need one
+    if (program) {
       std::string program_ext(fileExtension(program));
       if (program_ext == "bin") {
         ram.loadBinImage(program, STARTUP_ADDR);
       } else if (program_ext == "hex") {
         ram.loadHexImage(program);
+      } else if (program_ext == "elf" || RAM::isElfImage(program)) {
+        ram.loadElfImage(program, &startup_addr, &tohost_addr);
       } else {
-        std::cout << "*** error: only *.bin or *.hex images supported." << std::endl;
+        std::cout << "*** error: only *.bin, *.hex or ELF images supported." << std::endl;
         return -1;
       }
     }
@@ -0,0 +1,142 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <assert.h>
+#include <util.h>
+#include "memsim.h"
+#include "debug.h"
+
+using namespace tinyrv;
+
+MemSim::MemSim(const SimContext& ctx, const Config& config)
+  : SimObject<MemSim>(ctx, "memsim")
+  , MemReqPorts(config.num_ports, this)
+  , MemRspPorts(config.num_ports, this)
+  , config_(config)
+  , block_bits_(log2ceil(config.block_size))
+  , bank_bits_(log2ceil(config.num_banks))
+  , row_bits_(log2ceil(config.row_size / config.block_size))
+  , cycle_ratio_((config.cycle_ratio > 0) ? config.cycle_ratio : 1)
+  , banks_(config.num_banks)
+  , idle_(false) {
+  assert(ispow2(config.block_size));
+  assert(ispow2(config.num_banks));
+  assert(ispow2(config.row_size) && config.row_size >= config.block_size);
+  assert(config.queue_size != 0);
+}
+
+MemSim::~MemSim() {
+  //--
+}
+
+void MemSim::reset() {
+  queue_.clear();
+  for (auto& bank : banks_) {
+    bank.row_open = false;
+    bank.row = 0;
+    bank.busy_until = 0;
+  }
+  next_port_ = 0;
+  idle_ = false;
+  perf_stats_ = PerfStats();
+  perf_stats_.bank_busy.resize(banks_.size(), 0);
+}
+
+void MemSim::tick() {
+  bool progress = false;
+  auto cycles = SimPlatform::instance().cycles();
+
+  // enqueue new requests, rotating the first channel for fairness
+  for (uint32_t i = 0, n = MemReqPorts.size(); i < n; ++i) {
+    uint32_t port_id = (next_port_ + i) % n;
+    auto& req_port = MemReqPorts.at(port_id);
+    while (!req_port.empty()) {
+      if (queue_.size() >= config_.queue_size) {
+        ++perf_stats_.queue_stalls;
+        break;
+      }
+      auto& req = req_port.front();
+      uint64_t block = req.addr >> block_bits_;
+      uint32_t bank = block & (config_.num_banks - 1);
+      uint64_t row = (block >> bank_bits_) >> row_bits_;
+      DT(3, "mem-req: bank=" << bank << ", row=0x" << std::hex << row << std::dec << ", " << req);
+      queue_.push_back({req, port_id, bank, row, cycles});
+      req_port.pop();
+      progress = true;
+    }
+  }
+  next_port_ = (next_port_ + 1) % MemReqPorts.size();
+
+  // issue one request to each free bank
+  for (uint32_t b = 0, n = banks_.size(); b < n; ++b) {
+    if (banks_[b].busy_until <= cycles) {
+      progress |= this->schedule(b, cycles);
+    }
+  }
+
+  // stay awake while requests are waiting for their bank
+  idle_ = !progress && queue_.empty();
+}
+
+bool MemSim::schedule(uint32_t bank_id, uint64_t cycles) {
+  auto& bank = banks_.at(bank_id);
+
+  // first-ready: the oldest row hit, otherwise the oldest request
+  auto sel = queue_.end();
+  for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+    if (it->bank != bank_id)
+      continue;
+    if (bank.row_open && it->row == bank.row) {
+      sel = it;
+      break;
+    }
+    if (sel == queue_.end()) {
+      sel = it;
+    }
+  }
+  if (sel == queue_.end())
+    return false;
+
+  uint32_t mem_cycles = config_.tCAS + config_.tBurst;
+  if (bank.row_open && sel->row == bank.row) {
+    ++perf_stats_.row_hits;
+  } else {
+    if (bank.row_open) {
+      mem_cycles += config_.tRP;
+      ++perf_stats_.row_conflicts;
+    } else {
+      ++perf_stats_.row_misses;
+    }
+    mem_cycles += config_.tRCD;
+    bank.row_open = true;
+    bank.row = sel->row;
+  }
+
+  uint64_t service = uint64_t(mem_cycles) * cycle_ratio_;
+  bank.busy_until = cycles + service;
+  perf_stats_.bank_busy.at(bank_id) += service;
+
+  auto& req = sel->req;
+  if (req.write) {
+    ++perf_stats_.writes;
+  } else {
+    ++perf_stats_.reads;
+    uint64_t delay = service + config_.ctrl_latency;
+    perf_stats_.read_latency += (cycles - sel->arrival) + delay;
+    MemRspPorts.at(sel->port).send(MemRsp{req.tag, req.uuid}, delay);
+  }
+  DT(3, "mem-issue: bank=" << bank_id << ", cycles=" << service << ", " << req);
+  queue_.erase(sel);
+  return true;
+}
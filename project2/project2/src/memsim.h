@@ -0,0 +1,116 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <list>
+#include <vector>
+#include <simobject.h>
+#include "types.h"
+
+namespace tinyrv {
+
+// Banked DRAM main memory with one request/response channel per client.
+// Blocks are interleaved across the banks and each bank keeps its last row
+// open; requests wait in a shared queue and are scheduled first-ready
+// first-come-first-serve: the oldest row hit of a free bank goes first,
+// otherwise its oldest request. Reads are answered once their bank access
+// completes, writes occupy their bank but are not acknowledged.
+// Bank timings are in memory cycles, cycle_ratio core cycles each.
+class MemSim : public SimObject<MemSim> {
+public:
+  struct Config {
+    uint32_t num_ports;    // client channels
+    uint32_t num_banks;    // interleaved banks
+    uint32_t block_size;   // interleaving granularity in bytes
+    uint32_t row_size;     // bank row size in bytes
+    uint32_t queue_size;   // request queue entries
+    int      cycle_ratio;  // core cycles per memory cycle, <= 0 runs at the core clock
+    uint32_t tCAS;         // column access
+    uint32_t tRCD;         // row activation
+    uint32_t tRP;          // row precharge
+    uint32_t tBurst;       // block transfer
+    uint32_t ctrl_latency; // controller and interconnect core cycles
+  };
+
+  struct PerfStats {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t row_hits;
+    uint64_t row_misses;
+    uint64_t row_conflicts;
+    uint64_t queue_stalls;
+    uint64_t read_latency;
+    std::vector<uint64_t> bank_busy;
+
+    PerfStats()
+      : reads(0)
+      , writes(0)
+      , row_hits(0)
+      , row_misses(0)
+      , row_conflicts(0)
+      , queue_stalls(0)
+      , read_latency(0)
+    {}
+  };
+
+  std::vector<SimPort<MemReq>> MemReqPorts;
+  std::vector<SimPort<MemRsp>> MemRspPorts;
+
+  MemSim(const SimContext& ctx, const Config& config);
+
+  ~MemSim();
+
+  void reset();
+
+  void tick();
+
+  bool idle() const {
+    return idle_;
+  }
+
+  const PerfStats& perf_stats() const {
+    return perf_stats_;
+  }
+
+private:
+
+  struct request_t {
+    MemReq   req;
+    uint32_t port;
+    uint32_t bank;
+    uint64_t row;
+    uint64_t arrival;
+  };
+
+  struct bank_t {
+    bool     row_open;
+    uint64_t row;
+    uint64_t busy_until;
+  };
+
+  bool schedule(uint32_t bank_id, uint64_t cycles);
+
+  Config   config_;
+  uint32_t block_bits_;
+  uint32_t bank_bits_;
+  uint32_t row_bits_;
+  uint32_t cycle_ratio_;
+  std::list<request_t> queue_;
+  std::vector<bank_t>  banks_;
+  uint32_t next_port_;
+  bool     idle_;
+  PerfStats perf_stats_;
+};
+
+}
@@ -72,6 +72,16 @@ public:
   virtual pipeline_trace_t* commit() = 0;
 
   virtual void dump() = 0;
+
+  virtual void showStats() {}
+
+  // internal countdowns that advance without pending events
+  virtual bool busy() const {
+    return false;
+  }
+
+  // account for cycles skipped while the platform was idle
+  virtual void skip(uint64_t /*cycles*/) {}
 };
 
 }
\ No newline at end of file
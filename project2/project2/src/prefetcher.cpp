@@ -0,0 +1,142 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <assert.h>
+#include <util.h>
+#include "prefetcher.h"
+
+using namespace tinyrv;
+
+NextLinePrefetcher::NextLinePrefetcher(uint32_t line_size, uint32_t degree)
+  : line_size_(line_size)
+  , degree_(degree) {
+  //--
+}
+
+void NextLinePrefetcher::reset() {
+  //--
+}
+
+void NextLinePrefetcher::access(Word /*PC*/, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) {
+  if (!trigger)
+    return;
+  uint64_t line_addr = addr & ~uint64_t(line_size_ - 1);
+  for (uint32_t i = 1; i <= degree_; ++i) {
+    prefetches.push_back(line_addr + i * line_size_);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StridePrefetcher::StridePrefetcher(uint32_t line_size, uint32_t table_size, uint32_t degree)
+  : line_size_(line_size)
+  , degree_(degree)
+  , table_(table_size) {
+  assert(ispow2(table_size));
+  this->reset();
+}
+
+void StridePrefetcher::reset() {
+  for (auto& entry : table_) {
+    entry.valid = false;
+  }
+}
+
+void StridePrefetcher::access(Word PC, uint64_t addr, bool /*trigger*/, std::vector<uint64_t>& prefetches) {
+  auto& entry = table_[(PC >> 2) & (table_.size() - 1)];
+  if (!entry.valid || entry.PC != PC) {
+    entry.valid = true;
+    entry.PC = PC;
+    entry.last_addr = addr;
+    entry.stride = 0;
+    entry.confidence = 0;
+    return;
+  }
+
+  // 2-bit confidence, the stride is only replaced once it is cold
+  int64_t stride = int64_t(addr - entry.last_addr);
+  entry.last_addr = addr;
+  if (stride == entry.stride) {
+    if (entry.confidence < 3) {
+      ++entry.confidence;
+    }
+  } else if (entry.confidence != 0) {
+    --entry.confidence;
+  } else {
+    entry.stride = stride;
+  }
+
+  if (entry.confidence < 2 || entry.stride == 0)
+    return;
+
+  // short strides move a line at a time
+  int64_t step = entry.stride;
+  if (step > -int64_t(line_size_) && step < int64_t(line_size_)) {
+    step = (step > 0) ? int64_t(line_size_) : -int64_t(line_size_);
+  }
+  for (uint32_t i = 1; i <= degree_; ++i) {
+    prefetches.push_back(addr + i * step);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StreamPrefetcher::StreamPrefetcher(uint32_t line_size, uint32_t num_streams, uint32_t depth)
+  : line_bits_(log2ceil(line_size))
+  , depth_(depth)
+  , streams_(num_streams) {
+  this->reset();
+}
+
+void StreamPrefetcher::reset() {
+  for (auto& stream : streams_) {
+    stream.valid = false;
+    stream.last_use = 0;
+  }
+  use_counter_ = 0;
+}
+
+void StreamPrefetcher::access(Word /*PC*/, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) {
+  if (!trigger)
+    return;
+
+  uint64_t line = addr >> line_bits_;
+
+  // continue a stream whose window holds the line,
+  // otherwise restart the least recently used one
+  stream_t* match = nullptr;
+  stream_t* victim = &streams_[0];
+  for (auto& stream : streams_) {
+    if (stream.valid && line >= stream.next_line && line <= stream.head_line) {
+      match = &stream;
+      break;
+    }
+    if (!stream.valid || stream.last_use < victim->last_use) {
+      victim = &stream;
+    }
+  }
+  if (match == nullptr) {
+    match = victim;
+    match->valid = true;
+    match->head_line = line;
+  }
+  match->next_line = line + 1;
+  match->last_use = ++use_counter_;
+
+  // top the stream up to depth lines ahead
+  for (uint64_t l = match->head_line + 1; l <= line + depth_; ++l) {
+    prefetches.push_back(l << line_bits_);
+  }
+  match->head_line = std::max(match->head_line, line + depth_);
+}
@@ -0,0 +1,120 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+namespace tinyrv {
+
+// Cache prefetcher interface.
+// The cache reports every demand access, the prefetcher appends the byte
+// addresses it wants fetched; the cache drops lines that are already present
+// or in flight, and issues the others when an MSHR is free.
+class Prefetcher {
+public:
+  Prefetcher() {}
+  virtual ~Prefetcher() {}
+
+  virtual const char* name() const = 0;
+
+  virtual void reset() = 0;
+
+  // demand access at addr by instruction PC,
+  // trigger is set on misses and on first hits to prefetched lines
+  virtual void access(Word PC, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Fetches the next degree lines after each trigger (tagged next-line).
+class NextLinePrefetcher : public Prefetcher {
+public:
+  NextLinePrefetcher(uint32_t line_size, uint32_t degree);
+
+  const char* name() const override {
+    return "next-line";
+  }
+
+  void reset() override;
+
+  void access(Word PC, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) override;
+
+private:
+  uint32_t line_size_;
+  uint32_t degree_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Reference prediction table indexed by PC: once an instruction repeats the
+// same stride, fetches the next degree strides ahead, at least a line apart.
+class StridePrefetcher : public Prefetcher {
+public:
+  StridePrefetcher(uint32_t line_size, uint32_t table_size, uint32_t degree);
+
+  const char* name() const override {
+    return "stride";
+  }
+
+  void reset() override;
+
+  void access(Word PC, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) override;
+
+private:
+  struct entry_t {
+    bool     valid;
+    Word     PC;
+    uint64_t last_addr;
+    int64_t  stride;
+    uint32_t confidence;
+  };
+
+  uint32_t line_size_;
+  uint32_t degree_;
+  std::vector<entry_t> table_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Sequential stream buffers: a trigger that does not continue a tracked
+// stream allocates the least recently used one, and each stream is kept
+// depth lines ahead of its last trigger.
+class StreamPrefetcher : public Prefetcher {
+public:
+  StreamPrefetcher(uint32_t line_size, uint32_t num_streams, uint32_t depth);
+
+  const char* name() const override {
+    return "stream";
+  }
+
+  void reset() override;
+
+  void access(Word PC, uint64_t addr, bool trigger, std::vector<uint64_t>& prefetches) override;
+
+private:
+  struct stream_t {
+    bool     valid;
+    uint64_t next_line;
+    uint64_t head_line;
+    uint64_t last_use;
+  };
+
+  uint32_t line_bits_;
+  uint32_t depth_;
+  std::vector<stream_t> streams_;
+  uint64_t use_counter_;
+};
+
+}
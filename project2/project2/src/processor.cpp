@@ -16,6 +16,8 @@
 
 using namespace tinyrv;
 
+extern uint64_t fastforward_instrs;
+
 ProcessorImpl::ProcessorImpl() {
   // initialize simulator
   SimPlatform::instance().initialize();
@@ -42,6 +44,14 @@ void ProcessorImpl::attach_ram(RAM* ram) {
 int ProcessorImpl::run(bool riscv_test) {
   SimPlatform::instance().reset();
   this->reset();
+
+  // functional fast-forward before the timing simulation
+  if (fastforward_instrs != 0) {
+    core_->fast_forward(fastforward_instrs);
+    Word ec;
+    if (core_->check_exit(&ec, riscv_test))
+      return ec;
+  }
   
   bool done;
   Word exitcode = 0;
@@ -63,6 +73,8 @@ int ProcessorImpl::run(bool riscv_test) {
 
 void ProcessorImpl::showStats() {
   core_->showStats();
+  // only the simulator event pools, traces and their data are still heap allocated
+  std::cout << std::dec << "PERF: event pool heap allocs=" << mempool_heap_allocs() << std::endl;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
 #include <util.h>
 #include "types.h"
@@ -22,13 +23,26 @@
 
 using namespace tinyrv;
 
-Scoreboard::Scoreboard(Core* core, uint32_t num_RSs, uint32_t rob_size) 
+extern bool lsq_enabled;
+extern bool age_select_enabled;
+
+Scoreboard::Scoreboard(Core* core, uint32_t num_RSs, uint32_t rob_size, uint32_t commit_width) 
   : core_(core)  
   , RAT_(NUM_REGS)
   , RS_(num_RSs)
-  , RST_(rob_size, -1) {
+  , RST_(rob_size, -1)
+  , replay_stalls_(0)
+  , cycle_load_blocks_(0)
+  , cycle_full_stalls_(0)
+  , age_select_(age_select_enabled)
+  , issue_ports_({ALU_ISSUE_PORTS, LSU_ISSUE_PORTS, CSR_ISSUE_PORTS, MUL_ISSUE_PORTS, DIV_ISSUE_PORTS})
+  , port_stalls_() {
   // create the ROB
-  ROB_ = ReorderBuffer::Create(this, ROB_SIZE);
+  ROB_ = ReorderBuffer::Create(this, ROB_SIZE, commit_width);
+  // create the LSQ
+  if (lsq_enabled) {
+    LSQ_ = LoadStoreQueue::Create(LSQ_SIZE, SSIT_SIZE, LFST_SIZE);
+  }
 }
 
 Scoreboard::~Scoreboard() {
@@ -45,6 +59,16 @@ bool Scoreboard::issue(pipeline_trace_t* trace) {
    if (RS_.is_full ()|| ROB_->is_full()){ 
     return false;
   }
+  // replaying after a memory order violation
+  if (replay_stalls_ != 0) {
+    return false;
+  }
+  bool is_mem = LSQ_ && (trace->fu_type == FUType::LSU);
+  if (is_mem && LSQ_->is_full()) {
+    ++LSQ_->perf_stats().full_stalls;
+    ++cycle_full_stalls_;
+    return false;
+  }
 
   // TODO:
   // load renamed operands (rob1_index, rob2_index) from RAT
@@ -71,63 +95,138 @@ bool Scoreboard::issue(pipeline_trace_t* trace) {
 
   // update the RST with newly allocated RS index
   RST_[rob_index] = rs_index;
+
+  // memory operations also enter the LSQ in program order
+  if (is_mem) {
+    LSQ_->allocate(trace, rob_index);
+  }
   return true;
 }
 std::vector<pipeline_trace_t*> Scoreboard::execute() {
   std::vector<pipeline_trace_t*> traces;
   auto& FUs = core_->FUs_;
 
+  // committed stores write memory in order
+  if (LSQ_) {
+    cycle_load_blocks_ = 0;
+    cycle_full_stalls_ = 0;
+    if (replay_stalls_ != 0) {
+      --replay_stalls_;
+      ++LSQ_->perf_stats().replay_stalls;
+    }
+    while (auto drain_trace = LSQ_->next_drain()) {
+      FUs[(int)FUType::LSU]->Input.send({drain_trace, -1, -1});
+    }
+  }
+
+  // store addresses resolve as soon as their base register is available
+  if (LSQ_) {
+    for (int i = RS_.next_valid(0); i != -1; i = RS_.next_valid(i + 1)) {
+      auto& rs_entry = RS_[i];
+      if (!rs_entry.running && rs_entry.rs1_index == -1
+       && rs_entry.trace->fu_type == FUType::LSU && rs_entry.trace->slu_op == LsuOp::STORE) {
+        if (LSQ_->store_addr_ready(LSQ_->find(rs_entry.rob_index))) {
+          replay_stalls_ = LSQ_REPLAY_PENALTY;
+        }
+      }
+    }
+  }
+
   // TODO:
   // search the RS for any valid and not yet running entry
   // that is ready (i.e. both rs1_index and rs2_index are -1)
   // send it to its corresponding FUs
   // mark it as running
   // add its trace to return list
-  for (int i = 0; i < (int)RS_.size(); ++i) { 
-    auto& rs_entry = RS_[i];
-    // HERE!
-    // std::cout<<rs_entry.valid<<rs_entry.running<<rs_entry.rs1_index<<rs_entry.rs2_index<<"\n";
-    if (rs_entry.valid && !rs_entry.running && rs_entry.rs1_index == -1 && rs_entry.rs2_index == -1)
-    { // check if ready to run
-      // FU->Input.send(FunctionalUnit::entry_t{trace, rob_index, rs_index});//send the instruction to the FU
-      FUs[(int)rs_entry.trace->fu_type]->Input.send({rs_entry.trace, rs_entry.rob_index, i});
-      rs_entry.running = true;
-      traces.push_back(rs_entry.trace);
-  //  std::cout << "lolo" <<i<<"lolo";
+  if (!age_select_) {
+    for (int i = RS_.next_ready(0); i != -1; i = RS_.next_ready(i + 1)) {
+      this->dispatch(i, traces);
+    }
+    return traces;
+  }
+
+  // oldest ready entries first, each FU type accepts up to its issue ports per cycle
+  candidates_.clear();
+  for (int i = RS_.next_ready(0); i != -1; i = RS_.next_ready(i + 1)) {
+    candidates_.emplace_back(ROB_->age(RS_[i].rob_index), i);
+  }
+  std::sort(candidates_.begin(), candidates_.end());
+  std::array<uint32_t, NUM_FUS> used_ports = {};
+  for (auto& candidate : candidates_) {
+    int fu_type = (int)RS_[candidate.second].trace->fu_type;
+    if (issue_ports_[fu_type] != 0 && used_ports[fu_type] == issue_ports_[fu_type]) {
+      ++port_stalls_[fu_type];
+      continue;
+    }
+    if (this->dispatch(candidate.second, traces)) {
+      ++used_ports[fu_type];
     }
-    // std::cout<<RS_.size()<<i <<"---"<< rs_entry.trace<<"\n";
   }
   return traces;
 }
 
+bool Scoreboard::dispatch(int rs_index, std::vector<pipeline_trace_t*>& traces) {
+  auto& FUs = core_->FUs_;
+  auto& rs_entry = RS_[rs_index];
+  if (LSQ_ && rs_entry.trace->fu_type == FUType::LSU) {
+    int lsq_index = LSQ_->find(rs_entry.rob_index);
+    if (rs_entry.trace->slu_op == LsuOp::STORE) {
+      // stores complete once their address and data are known
+      LSQ_->store_data_ready(lsq_index);
+      LSQ_->Output.send({rs_entry.trace, rs_entry.rob_index, rs_index});
+      RS_.set_running(rs_index);
+      traces.push_back(rs_entry.trace);
+      return true;
+    }
+    auto status = LSQ_->check_load(lsq_index);
+    if (status == LoadStoreQueue::LOAD_BLOCKED) {
+      ++cycle_load_blocks_;
+      return false;
+    }
+    if (status == LoadStoreQueue::LOAD_FORWARD) {
+      LSQ_->Output.send({rs_entry.trace, rs_entry.rob_index, rs_index}, LSQ_FORWARD_LATENCY);
+      RS_.set_running(rs_index);
+      traces.push_back(rs_entry.trace);
+      return true;
+    }
+  }
+  // FU->Input.send(FunctionalUnit::entry_t{trace, rob_index, rs_index});//send the instruction to the FU
+  FUs[(int)rs_entry.trace->fu_type]->Input.send({rs_entry.trace, rs_entry.rob_index, rs_index});
+  RS_.set_running(rs_index);
+  traces.push_back(rs_entry.trace);
+  return true;
+}
+
 pipeline_trace_t* Scoreboard::writeback() {
   pipeline_trace_t* trace = nullptr;
   auto& ROB = ROB_;
   auto& FUs = core_->FUs_;
 
   // process the first FU to have completed execution by accessing its output
+  SimPort<FunctionalUnit::entry_t>* output = nullptr;
   for (auto& fu : FUs) {
-    if (fu->Output.empty())
-      continue;
+    // drained stores only release their LSQ entry
+    while (LSQ_ && !fu->Output.empty() && fu->Output.front().rob_index < 0) {
+      LSQ_->drained(fu->Output.front().trace);
+      fu->Output.pop();
+    }
+    if (!fu->Output.empty()) {
+      output = &fu->Output;
+      break;
+    }
+  }
+  // then the LSQ forwarded loads and stores
+  if (output == nullptr && LSQ_ && !LSQ_->Output.empty()) {
+    output = &LSQ_->Output;
+  }
 
-    auto& fu_entry = fu->Output.front();
+  if (output != nullptr) {
+    auto& fu_entry = output->front();
 
     // TODO:
     // broadcast result to all RS pending for this FU's rs_index
     // invalidate matching rs_index by setting it to -1 to imply that the operand value is now available
-    for (uint32_t i = 0; i < RS_.size(); ++i) { 
-      auto& rs_entry = RS_[i];
-      if (!rs_entry.valid)
-        continue;
-      // HERE!
-     if (rs_entry.rs1_index == fu_entry.rs_index){
-        rs_entry.rs1_index = -1;
-     }
-     if (rs_entry.rs2_index == fu_entry.rs_index){
-        rs_entry.rs2_index = -1;
-     }
-    //  std::cout << "infinite loop writeback";
-    }
+    RS_.wakeup(fu_entry.rs_index);
     
     // TODO: 
     // clear RST by invalidating current ROB entry to -1
@@ -143,10 +242,7 @@ pipeline_trace_t* Scoreboard::writeback() {
     trace = fu_entry.trace;
 
     // remove FU entry
-    fu->Output.pop();
-
-    // we process one FU at the time
-    break;
+    output->pop();
   }
 
   return trace;
@@ -157,6 +253,9 @@ pipeline_trace_t* Scoreboard::commit() {
   if (!ROB_->Committed.empty()) {
     trace = ROB_->Committed.front();
     ROB_->Committed.pop();
+    if (LSQ_ && trace->fu_type == FUType::LSU) {
+      LSQ_->commit(trace);
+    }
   }
   return trace;
 }
@@ -164,4 +263,33 @@ pipeline_trace_t* Scoreboard::commit() {
 void Scoreboard::dump() {
   RS_.dump();
   ROB_->dump();
+  if (LSQ_) {
+    LSQ_->dump();
+  }
+}
+
+void Scoreboard::skip(uint64_t cycles) {
+  // the stalled loads and issue retry in every skipped cycle
+  if (LSQ_) {
+    LSQ_->perf_stats().load_blocks += cycle_load_blocks_ * cycles;
+    LSQ_->perf_stats().full_stalls += cycle_full_stalls_ * cycles;
+  }
+}
+
+void Scoreboard::showStats() {
+  if (age_select_) {
+    std::cout << std::dec << "PERF: issue port stalls alu=" << port_stalls_[(int)FUType::ALU] 
+              << ", lsu=" << port_stalls_[(int)FUType::LSU] 
+              << ", csr=" << port_stalls_[(int)FUType::CSR] 
+              << ", mul=" << port_stalls_[(int)FUType::MUL] 
+              << ", div=" << port_stalls_[(int)FUType::DIV] << std::endl;
+  }
+  if (LSQ_) {
+    auto& stats = LSQ_->perf_stats();
+    std::cout << std::dec << "PERF: lsq loads=" << stats.loads << ", stores=" << stats.stores 
+              << ", forwards=" << stats.forwards << ", blocked loads=" << stats.load_blocks 
+              << ", full stalls=" << stats.full_stalls << std::endl;
+    std::cout << std::dec << "PERF: lsq speculative loads=" << stats.speculative << ", order violations=" << stats.violations 
+              << ", false dependencies=" << stats.false_deps << ", replay stalls=" << stats.replay_stalls << std::endl;
+  }
 }
\ No newline at end of file
@@ -13,10 +13,12 @@
 
 #pragma once
 
+#include <array>
 #include "pipeline.h"
 #include "RAT.h"
 #include "RS.h"
 #include "ROB.h"
+#include "LSQ.h"
 
 namespace tinyrv {
 
@@ -29,7 +31,7 @@ typedef std::vector<int> RegisterStatusTable;
 
 class Scoreboard : public Pipeline {
 public:
-  Scoreboard(Core* core, uint32_t num_RSs, uint32_t rob_size);
+  Scoreboard(Core* core, uint32_t num_RSs, uint32_t rob_size, uint32_t commit_width);
 
   ~Scoreboard();
 
@@ -43,14 +45,35 @@ public:
 
   void dump() override;
 
+  void showStats() override;
+
+  void skip(uint64_t cycles) override;
+
+  bool busy() const override {
+    return (replay_stalls_ != 0);
+  }
+
 private:
 
+  // send a ready RS entry to its FU or the LSQ, false if the load is blocked
+  bool dispatch(int rs_index, std::vector<pipeline_trace_t*>& traces);
+
   Core* core_;
   
   RegisterAliasTable RAT_;  
   ReservationStation RS_;
   RegisterStatusTable RST_;  
   ReorderBuffer::Ptr ROB_;
+  LoadStoreQueue::Ptr LSQ_; // memory ordering, enabled with -l
+  uint32_t replay_stalls_;
+  uint32_t cycle_load_blocks_;  // LSQ stalls of the last cycle,
+  uint32_t cycle_full_stalls_;  // repeated in every skipped cycle
+
+  // age-ordered select, enabled with -a
+  bool age_select_;
+  std::array<uint32_t, NUM_FUS> issue_ports_; // per FU type, 0 is unlimited
+  std::array<uint64_t, NUM_FUS> port_stalls_;
+  std::vector<std::pair<uint32_t, int>> candidates_; // (ROB age, RS index)
   
   friend class ReorderBuffer;
 };
@@ -0,0 +1,88 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <assert.h>
+#include <util.h>
+#include "storeset.h"
+
+using namespace tinyrv;
+
+StoreSetPredictor::StoreSetPredictor(uint32_t ssit_size, uint32_t lfst_size)
+  : ssit_(ssit_size)
+  , lfst_(lfst_size) {
+  assert(ssit_size == 0 || (ispow2(ssit_size) && ispow2(lfst_size)));
+  this->reset();
+}
+
+StoreSetPredictor::~StoreSetPredictor() {
+  //--
+}
+
+void StoreSetPredictor::reset() {
+  std::fill(ssit_.begin(), ssit_.end(), int(INVALID_SSID));
+  for (auto& entry : lfst_) {
+    entry.valid = false;
+  }
+}
+
+uint64_t StoreSetPredictor::load_dispatch(Word PC) const {
+  if (!this->enabled())
+    return 0;
+  int ssid = ssit_[this->ssit_index(PC)];
+  if (ssid == INVALID_SSID || !lfst_[ssid].valid)
+    return 0;
+  return lfst_[ssid].seq;
+}
+
+void StoreSetPredictor::store_dispatch(Word PC, uint64_t seq) {
+  if (!this->enabled())
+    return;
+  int ssid = ssit_[this->ssit_index(PC)];
+  if (ssid == INVALID_SSID)
+    return;
+  lfst_[ssid] = {true, seq};
+}
+
+void StoreSetPredictor::store_execute(Word PC, uint64_t seq) {
+  if (!this->enabled())
+    return;
+  int ssid = ssit_[this->ssit_index(PC)];
+  if (ssid == INVALID_SSID)
+    return;
+  if (lfst_[ssid].valid && lfst_[ssid].seq == seq) {
+    lfst_[ssid].valid = false;
+  }
+}
+
+void StoreSetPredictor::violation(Word load_PC, Word store_PC) {
+  if (!this->enabled())
+    return;
+  auto& load_ssid = ssit_[this->ssit_index(load_PC)];
+  auto& store_ssid = ssit_[this->ssit_index(store_PC)];
+  if (load_ssid == INVALID_SSID && store_ssid == INVALID_SSID) {
+    // new set named after the store
+    int ssid = (store_PC >> 2) & (lfst_.size() - 1);
+    load_ssid = ssid;
+    store_ssid = ssid;
+  } else if (load_ssid == INVALID_SSID) {
+    load_ssid = store_ssid;
+  } else if (store_ssid == INVALID_SSID) {
+    store_ssid = load_ssid;
+  } else {
+    // merge both sets into the smaller ID
+    int ssid = std::min(load_ssid, store_ssid);
+    load_ssid = ssid;
+    store_ssid = ssid;
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+namespace tinyrv {
+
+// Store-set memory dependence predictor.
+// The store set ID table (SSIT), indexed by instruction PC, groups loads with
+// the stores they have conflicted with; the last fetched store table (LFST)
+// holds, for each set, the most recent in-flight store a new load of that set
+// must wait for. Sets are created and merged on ordering violations.
+class StoreSetPredictor {
+public:
+  StoreSetPredictor(uint32_t ssit_size, uint32_t lfst_size);
+
+  ~StoreSetPredictor();
+
+  void reset();
+
+  bool enabled() const {
+    return !ssit_.empty();
+  }
+
+  // load dispatch, returns the sequence number of the store to wait for or 0
+  uint64_t load_dispatch(Word PC) const;
+
+  // store dispatch, records the store as its set's last one
+  void store_dispatch(Word PC, uint64_t seq);
+
+  // the store has executed, later loads of its set no longer wait for it
+  void store_execute(Word PC, uint64_t seq);
+
+  // the load at load_PC read stale data, bypassing the store at store_PC
+  void violation(Word load_PC, Word store_PC);
+
+private:
+
+  enum { INVALID_SSID = -1 };
+
+  struct lfst_entry_t {
+    bool     valid;
+    uint64_t seq;
+  };
+
+  uint32_t ssit_index(Word PC) const {
+    return (PC >> 2) & (ssit_.size() - 1);
+  }
+
+  std::vector<int> ssit_;
+  std::vector<lfst_entry_t> lfst_;
+};
+
+}
@@ -0,0 +1,243 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <memory>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tracefile.h"
+#include "trace.h"
+
+using namespace tinyrv;
+
+#define TRACE_VERSION     1
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+static const char trace_magic[4] = {'T', 'R', 'V', 'T'};
+
+static uint64_t zigzag_encode(int64_t value) {
+  return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value) {
+  return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TraceWriter::TraceWriter(const std::string& filename)
+  : filename_(filename)
+  , ofs_(filename, std::ios::binary | std::ios::trunc)
+  , next_PC_(0)
+  , mem_addr_(0)
+  , closed_(false) {
+  if (!ofs_) {
+    std::cout << "error: cannot create trace file " << filename << std::endl;
+    std::abort();
+  }
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, trace_magic, sizeof(trace_magic));
+  header_.version = TRACE_VERSION;
+  // reserve the header, it is updated on close
+  ofs_.write((const char*)&header_, sizeof(header_));
+  buffer_.reserve(TRACE_BUFFER_SIZE);
+}
+
+TraceWriter::~TraceWriter() {
+  if (!closed_) {
+    // program did not exit, keep the trace replayable
+    this->flush();
+    ofs_.seekp(0);
+    ofs_.write((const char*)&header_, sizeof(header_));
+  }
+}
+
+void TraceWriter::write(const pipeline_trace_t& trace) {
+  if (closed_)
+    return;
+
+  if (header_.num_instrs == 0) {
+    header_.start_PC = trace.PC;
+    next_PC_ = trace.PC;
+  }
+
+  uint64_t mem_addr = 0;
+  uint32_t mem_size = 0;
+  bool has_mem = false;
+  if (trace.fu_type == FUType::LSU && trace.data) {
+    auto lsu_data = std::dynamic_pointer_cast<LsuTraceData>(trace.data);
+    if (lsu_data) {
+      mem_addr = lsu_data->mem_addrs.addr;
+      mem_size = lsu_data->mem_addrs.size;
+      has_mem = true;
+    }
+  }
+
+  uint8_t flags = (uint32_t(trace.fu_type) & 0x7)
+                | ((trace.fu_op & 0x7) << 3)
+                | (trace.wb << 6)
+                | (trace.isTaken << 7);
+  buffer_.push_back(flags);
+  this->put_varint(trace.rd | (trace.rs1 << 5) | (trace.rs2 << 10) | (has_mem << 15));
+
+  bool pc_jump = (trace.PC != next_PC_);
+  int64_t next_delta = int64_t(trace.nextPC) - int64_t(trace.PC + 4);
+  this->put_varint((zigzag_encode(next_delta) << 1) | pc_jump);
+  if (pc_jump) {
+    this->put_varint(zigzag_encode(int64_t(trace.PC) - int64_t(next_PC_)));
+  }
+
+  if (has_mem) {
+    this->put_varint(zigzag_encode(int64_t(mem_addr - mem_addr_)));
+    this->put_varint(mem_size);
+    mem_addr_ = mem_addr;
+  }
+
+  next_PC_ = trace.nextPC;
+  ++header_.num_instrs;
+
+  if (buffer_.size() >= TRACE_BUFFER_SIZE) {
+    this->flush();
+  }
+}
+
+void TraceWriter::close(Word exitcode, bool direct) {
+  if (closed_)
+    return;
+  this->flush();
+  header_.exited = 1;
+  header_.exitcode = exitcode;
+  header_.exit_direct = direct;
+  ofs_.seekp(0);
+  ofs_.write((const char*)&header_, sizeof(header_));
+  ofs_.close();
+  closed_ = true;
+}
+
+void TraceWriter::put_varint(uint64_t value) {
+  while (value >= 0x80) {
+    buffer_.push_back(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  buffer_.push_back(uint8_t(value));
+}
+
+void TraceWriter::flush() {
+  ofs_.write((const char*)buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TraceReader::TraceReader(const std::string& filename)
+  : data_(nullptr)
+  , size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "error: " << filename << " not found" << std::endl;
+    std::abort();
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(trace_header_t)) {
+    std::cout << "error: invalid trace file " << filename << std::endl;
+    std::abort();
+  }
+  size_ = st.st_size;
+  auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cout << "error: cannot map trace file " << filename << std::endl;
+    std::abort();
+  }
+  data_ = (const uint8_t*)data;
+  madvise(data, size_, MADV_SEQUENTIAL);
+
+  memcpy(&header_, data_, sizeof(header_));
+  if (memcmp(header_.magic, trace_magic, sizeof(trace_magic)) != 0
+   || header_.version != TRACE_VERSION) {
+    std::cout << "error: invalid trace file " << filename << std::endl;
+    std::abort();
+  }
+
+  this->rewind();
+}
+
+TraceReader::~TraceReader() {
+  munmap((void*)data_, size_);
+}
+
+void TraceReader::rewind() {
+  cur_ = data_ + sizeof(trace_header_t);
+  count_ = 0;
+  next_PC_ = header_.start_PC;
+  mem_addr_ = 0;
+}
+
+pipeline_trace_t* TraceReader::read(uint64_t uuid) {
+  if (this->done())
+    return nullptr;
+
+  if (cur_ >= data_ + size_) {
+    std::cout << "error: truncated trace file" << std::endl;
+    std::abort();
+  }
+  uint8_t flags = *cur_++;
+  uint64_t regs = this->get_varint();
+  uint64_t next = this->get_varint();
+
+  Word PC = next_PC_;
+  if (next & 1) {
+    PC += zigzag_decode(this->get_varint());
+  }
+
+  auto trace = new pipeline_trace_t(uuid, PC);
+  trace->fu_type = FUType(flags & 0x7);
+  trace->fu_op   = (flags >> 3) & 0x7;
+  trace->wb      = (flags >> 6) & 0x1;
+  trace->isTaken = (flags >> 7) & 0x1;
+  trace->rd      = regs & 0x1f;
+  trace->rs1     = (regs >> 5) & 0x1f;
+  trace->rs2     = (regs >> 10) & 0x1f;
+  trace->nextPC  = PC + 4 + zigzag_decode(next >> 1);
+
+  if ((regs >> 15) & 0x1) {
+    auto trace_data = std::make_shared<LsuTraceData>();
+    mem_addr_ += zigzag_decode(this->get_varint());
+    trace_data->mem_addrs = {mem_addr_, (uint32_t)this->get_varint()};
+    trace->data = trace_data;
+  }
+
+  next_PC_ = trace->nextPC;
+  ++count_;
+  return trace;
+}
+
+uint64_t TraceReader::get_varint() {
+  uint64_t value = 0;
+  uint32_t shift = 0;
+  const uint8_t* end = data_ + size_;
+  while (cur_ < end) {
+    uint8_t byte = *cur_++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+    shift += 7;
+  }
+  std::cout << "error: truncated trace file" << std::endl;
+  std::abort();
+  return 0;
+}
@@ -0,0 +1,113 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "types.h"
+
+namespace tinyrv {
+
+class pipeline_trace_t;
+
+// Binary instruction trace file layout:
+//  trace_header_t, followed by one variable-length record per instruction.
+//  record := flags:u8 regs:varint next:varint [pc:varint] [addr:varint size:varint]
+//   flags = fu_type[2:0] | fu_op[5:3] | wb[6] | isTaken[7]
+//   regs  = rd | rs1 << 5 | rs2 << 10 | mem << 15
+//   next  = zigzag(nextPC - (PC + 4)) << 1 | pc_jump
+//   pc    = zigzag(PC - expected PC), present when pc_jump is set
+//   addr  = zigzag(addr - previous addr), present for memory accesses
+//  The expected PC is the previous record's nextPC.
+struct trace_header_t {
+  char     magic[4];
+  uint32_t version;
+  uint64_t num_instrs;
+  uint32_t start_PC;
+  uint32_t exited;
+  uint32_t exitcode;
+  uint32_t exit_direct;
+};
+
+class TraceWriter {
+public:
+  TraceWriter(const std::string& filename);
+  ~TraceWriter();
+
+  void write(const pipeline_trace_t& trace);
+
+  // finalize the trace with the program exit code,
+  // direct codes are reported as is, otherwise they hold the test status register
+  void close(Word exitcode, bool direct);
+
+  uint64_t num_instrs() const {
+    return header_.num_instrs;
+  }
+
+private:
+
+  void put_varint(uint64_t value);
+
+  void flush();
+
+  std::string filename_;
+  std::ofstream ofs_;
+  std::vector<uint8_t> buffer_;
+  trace_header_t header_;
+  Word next_PC_;
+  uint64_t mem_addr_;
+  bool closed_;
+};
+
+class TraceReader {
+public:
+  TraceReader(const std::string& filename);
+  ~TraceReader();
+
+  // decode the next instruction, returns nullptr at the end of the trace
+  pipeline_trace_t* read(uint64_t uuid);
+
+  void rewind();
+
+  bool done() const {
+    return (count_ == header_.num_instrs);
+  }
+
+  bool exited() const {
+    return header_.exited && this->done();
+  }
+
+  Word exitcode() const {
+    return header_.exitcode;
+  }
+
+  bool exit_direct() const {
+    return header_.exit_direct;
+  }
+
+private:
+
+  uint64_t get_varint();
+
+  const uint8_t* data_;
+  size_t size_;
+  const uint8_t* cur_;
+  trace_header_t header_;
+  uint64_t count_;
+  Word next_PC_;
+  uint64_t mem_addr_;
+};
+
+}
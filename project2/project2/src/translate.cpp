@@ -0,0 +1,326 @@
+// Copyright 2024 Blaise Tine
+//
+// Licensed under the Apache License;
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <stdlib.h>
+#include <climits>
+#include <assert.h>
+#include <util.h>
+#include "instr.h"
+#include "core.h"
+#include "emulator.h"
+#include "trace.h"
+
+using namespace tinyrv;
+
+// Functional fast-forward path.
+// Straight-line code is translated into basic blocks of pre-decoded
+// operations, each bound to its handler so that execution skips the
+// opcode/func3/func7 dispatch of Emulator::execute().
+// Blocks end at the first control transfer or system instruction and
+// are chained to their successors to bypass the block lookup.
+// Fast-forwarded instructions count as one cycle each in the counters.
+
+uint64_t Emulator::run_functional(uint64_t max_instrs) {
+  uint64_t instrs = 0;
+  basic_block_t* block = nullptr;
+
+  if (trace_reader_) {
+    // replay: skip the recorded instructions
+    while (instrs < max_instrs && !trace_reader_->done()) {
+      delete trace_reader_->read(replay_uuid_++);
+      ++instrs;
+    }
+    core_->perf_stats_.ff_instrs += instrs;
+    return instrs;
+  }
+
+  if (blocks_dirty_) {
+    this->flush_blocks();
+  }
+
+  while (instrs < max_instrs && !exited_) {
+    // follow the chained successor
+    basic_block_t* next = nullptr;
+    int slot = 0;
+    if (block) {
+      slot = (PC_ != block->end_PC);
+      next = block->next[slot];
+      if (next && next->PC != PC_) {
+        next = nullptr;
+      }
+    }
+    if (!next) {
+      next = this->lookup_block(PC_);
+      if (block) {
+        block->next[slot] = next;
+      }
+    }
+    block = next;
+
+    // execute the block
+    auto op = block->ops.data();
+    auto op_end = op + std::min<uint64_t>(block->ops.size(), max_instrs - instrs);
+    bool fallthrough = true;
+    while (op != op_end) {
+      auto& curr = *op++;
+      if (!curr.handler(this, curr)) {
+        fallthrough = false;
+        break;
+      }
+    }
+    instrs += (op - block->ops.data());
+    core_->perf_stats_.ff_instrs += (op - block->ops.data());
+    if (fallthrough) {
+      PC_ = (op - 1)->PC + 4;
+    }
+
+    if (blocks_dirty_) {
+      // the code was modified, drop all translations
+      this->flush_blocks();
+      block = nullptr;
+    }
+  }
+
+  return instrs;
+}
+
+Emulator::basic_block_t* Emulator::lookup_block(Word PC) {
+  auto it = blocks_.find(PC);
+  if (it != blocks_.end())
+    return it->second.get();
+
+  std::unique_ptr<basic_block_t> block(new basic_block_t());
+  block->PC = PC;
+  block->next[0] = nullptr;
+  block->next[1] = nullptr;
+
+  auto page_bits = log2ceil(RAM_PAGE_SIZE);
+  Word pc = PC;
+  bool terminal = false;
+  while (!terminal && block->ops.size() < BASIC_BLOCK_SIZE) {
+    uint32_t instr_code = 0;
+    this->icache_read(&instr_code, pc, sizeof(uint32_t));
+    code_pages_[(pc >> page_bits) & (code_pages_.size() - 1)] = true;
+
+    Instr instr;
+    if (!this->decode(instr_code, &instr)) {
+      if (block->ops.empty()) {
+        std::cout << std::hex << "Error: invalid instruction 0x" << instr_code << ", at PC=0x" << pc << std::endl;
+        std::abort();
+      }
+      // stop before the invalid instruction
+      break;
+    }
+
+    if (instr.getOpcode() == Opcode::SYS 
+     && instr.getFunc3() != 0
+     && !block->ops.empty()) {
+      // CSR accesses start their own block so that counters read exactly
+      break;
+    }
+
+    bb_op_t op;
+    op.PC  = pc;
+    op.rd  = instr.getRDest();
+    op.rs1 = instr.getRSrc(0);
+    op.rs2 = instr.getRSrc(1);
+    op.imm = sext((Word)instr.getImm(), 32);
+    terminal = this->translate(instr, &op);
+    block->ops.push_back(op);
+    pc += 4;
+  }
+  block->end_PC = pc;
+
+  auto ptr = block.get();
+  blocks_.emplace(PC, std::move(block));
+  return ptr;
+}
+
+void Emulator::flush_blocks() {
+  blocks_.clear();
+  std::fill(code_pages_.begin(), code_pages_.end(), false);
+  blocks_dirty_ = false;
+}
+
+// bind the instruction to its handler, return true if it ends the block
+bool Emulator::translate(const Instr& instr, bb_op_t* op) {
+  auto func3 = instr.getFunc3();
+  auto func7 = instr.getFunc7();
+
+  #define BB_OP(x) [](Emulator* emu, const bb_op_t& op)->bool { __unused(emu, op); x; }
+  #define RS1 emu->reg_file_[op.rs1]
+  #define RS2 emu->reg_file_[op.rs2]
+  #define RD(x) do { if (op.rd != 0) { emu->reg_file_[op.rd] = (x); } } while (0)
+  #define SHAMT_MASK ((Word(1) << log2up(XLEN)) - 1)
+
+  switch (instr.getOpcode()) {
+  case Opcode::LUI:
+    op->handler = BB_OP(RD(op.imm); return true);
+    return false;
+  case Opcode::AUIPC:
+    op->handler = BB_OP(RD(op.imm + op.PC); return true);
+    return false;
+  case Opcode::R:
+    if (func7 & 0x1) {
+      // RV32M, division by zero and overflow follow the ISA defined results
+      switch (func3) {
+      case 0: op->handler = BB_OP(RD(RS1 * RS2); return true); break;
+      case 1: op->handler = BB_OP(RD((int64_t(WordI(RS1)) * int64_t(WordI(RS2))) >> 32); return true); break;
+      case 2: op->handler = BB_OP(RD((int64_t(WordI(RS1)) * int64_t(RS2)) >> 32); return true); break;
+      case 3: op->handler = BB_OP(RD((uint64_t(RS1) * uint64_t(RS2)) >> 32); return true); break;
+      case 4: op->handler = BB_OP(RD((RS2 == 0) ? Word(-1) : (WordI(RS1) == INT_MIN && WordI(RS2) == -1) ? RS1 : Word(WordI(RS1) / WordI(RS2))); return true); break;
+      case 5: op->handler = BB_OP(RD((RS2 == 0) ? Word(-1) : (RS1 / RS2)); return true); break;
+      case 6: op->handler = BB_OP(RD((RS2 == 0) ? RS1 : (WordI(RS1) == INT_MIN && WordI(RS2) == -1) ? 0 : Word(WordI(RS1) % WordI(RS2))); return true); break;
+      case 7: op->handler = BB_OP(RD((RS2 == 0) ? RS1 : (RS1 % RS2)); return true); break;
+      default:
+        std::abort();
+      }
+      return false;
+    }
+    switch (func3) {
+    case 0:
+      if (func7) {
+        op->handler = BB_OP(RD(RS1 - RS2); return true);
+      } else {
+        op->handler = BB_OP(RD(RS1 + RS2); return true);
+      }
+      break;
+    case 1: op->handler = BB_OP(RD(RS1 << (RS2 & SHAMT_MASK)); return true); break;
+    case 2: op->handler = BB_OP(RD(WordI(RS1) < WordI(RS2)); return true); break;
+    case 3: op->handler = BB_OP(RD(RS1 < RS2); return true); break;
+    case 4: op->handler = BB_OP(RD(RS1 ^ RS2); return true); break;
+    case 5:
+      if (func7) {
+        op->handler = BB_OP(RD(WordI(RS1) >> (RS2 & SHAMT_MASK)); return true);
+      } else {
+        op->handler = BB_OP(RD(RS1 >> (RS2 & SHAMT_MASK)); return true);
+      }
+      break;
+    case 6: op->handler = BB_OP(RD(RS1 | RS2); return true); break;
+    case 7: op->handler = BB_OP(RD(RS1 & RS2); return true); break;
+    default:
+      std::abort();
+    }
+    return false;
+  case Opcode::I:
+    switch (func3) {
+    case 0: op->handler = BB_OP(RD(RS1 + op.imm); return true); break;
+    case 1: op->handler = BB_OP(RD(RS1 << op.imm); return true); break;
+    case 2: op->handler = BB_OP(RD(WordI(RS1) < WordI(op.imm)); return true); break;
+    case 3: op->handler = BB_OP(RD(RS1 < op.imm); return true); break;
+    case 4: op->handler = BB_OP(RD(RS1 ^ op.imm); return true); break;
+    case 5:
+      if (func7) {
+        op->handler = BB_OP(RD(WordI(RS1) >> op.imm); return true);
+      } else {
+        op->handler = BB_OP(RD(RS1 >> op.imm); return true);
+      }
+      break;
+    case 6: op->handler = BB_OP(RD(RS1 | op.imm); return true); break;
+    case 7: op->handler = BB_OP(RD(RS1 & op.imm); return true); break;
+    default:
+      std::abort();
+    }
+    return false;
+  case Opcode::B:
+    switch (func3) {
+    case 0: op->handler = BB_OP(emu->PC_ = (RS1 == RS2) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    case 1: op->handler = BB_OP(emu->PC_ = (RS1 != RS2) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    case 4: op->handler = BB_OP(emu->PC_ = (WordI(RS1) < WordI(RS2)) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    case 5: op->handler = BB_OP(emu->PC_ = (WordI(RS1) >= WordI(RS2)) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    case 6: op->handler = BB_OP(emu->PC_ = (RS1 < RS2) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    case 7: op->handler = BB_OP(emu->PC_ = (RS1 >= RS2) ? (op.PC + op.imm) : (op.PC + 4); return false); break;
+    default:
+      std::abort();
+    }
+    return true;
+  case Opcode::JAL:
+    op->handler = BB_OP(RD(op.PC + 4); emu->PC_ = op.PC + op.imm; return false);
+    return true;
+  case Opcode::JALR:
+    op->handler = BB_OP(Word target = RS1 + op.imm; RD(op.PC + 4); emu->PC_ = target; return false);
+    return true;
+  case Opcode::L:
+    switch (func3) {
+    case 0: op->handler = BB_OP(uint8_t data = 0; emu->dcache_read(&data, Word(RS1 + op.imm), 1); RD(sext(Word(data), 8)); return true); break;
+    case 1: op->handler = BB_OP(uint16_t data = 0; emu->dcache_read(&data, Word(RS1 + op.imm), 2); RD(sext(Word(data), 16)); return true); break;
+    case 2: op->handler = BB_OP(uint32_t data = 0; emu->dcache_read(&data, Word(RS1 + op.imm), 4); RD(data); return true); break;
+    case 4: op->handler = BB_OP(uint8_t data = 0; emu->dcache_read(&data, Word(RS1 + op.imm), 1); RD(data); return true); break;
+    case 5: op->handler = BB_OP(uint16_t data = 0; emu->dcache_read(&data, Word(RS1 + op.imm), 2); RD(data); return true); break;
+    default:
+      std::abort();
+    }
+    return false;
+  case Opcode::S:
+    // stores stop the block if they modified translated code
+    #define BB_STORE(T) BB_OP( \
+      T data = T(RS2); \
+      emu->dcache_write(&data, Word(RS1 + op.imm), sizeof(T)); \
+      if (emu->blocks_dirty_) { emu->PC_ = op.PC + 4; return false; } \
+      return true)
+    switch (func3) {
+    case 0: op->handler = BB_STORE(uint8_t); break;
+    case 1: op->handler = BB_STORE(uint16_t); break;
+    case 2: op->handler = BB_STORE(uint32_t); break;
+    default:
+      std::abort();
+    }
+    #undef BB_STORE
+    return false;
+  case Opcode::SYS:
+    if (func3 == 0) {
+      switch (op->imm) {
+      case 0: op->handler = BB_OP(emu->trigger_ecall(); emu->PC_ = op.PC + 4; return false); break;
+      case 1: op->handler = BB_OP(emu->trigger_ebreak(); emu->PC_ = op.PC + 4; return false); break;
+      case 0x002: // URET
+      case 0x102: // SRET
+      case 0x302: // MRET
+        op->handler = BB_OP(emu->PC_ = op.PC + 4; return false);
+        break;
+      default:
+        std::abort();
+      }
+    } else {
+      // CSR accesses end the block since they may observe the core state
+      switch (func3) {
+      case 1: op->handler = BB_OP(auto v = emu->get_csr(op.imm); emu->set_csr(op.imm, RS1); RD(v); emu->PC_ = op.PC + 4; return false); break;
+      case 2: op->handler = BB_OP(auto v = emu->get_csr(op.imm); if (RS1 != 0) { emu->set_csr(op.imm, v | RS1); } RD(v); emu->PC_ = op.PC + 4; return false); break;
+      case 3: op->handler = BB_OP(auto v = emu->get_csr(op.imm); if (RS1 != 0) { emu->set_csr(op.imm, v & ~RS1); } RD(v); emu->PC_ = op.PC + 4; return false); break;
+      case 5: op->handler = BB_OP(auto v = emu->get_csr(op.imm); emu->set_csr(op.imm, op.rs1); RD(v); emu->PC_ = op.PC + 4; return false); break;
+      case 6: op->handler = BB_OP(auto v = emu->get_csr(op.imm); if (op.rs1 != 0) { emu->set_csr(op.imm, v | op.rs1); } RD(v); emu->PC_ = op.PC + 4; return false); break;
+      case 7: op->handler = BB_OP(auto v = emu->get_csr(op.imm); if (op.rs1 != 0) { emu->set_csr(op.imm, v & ~op.rs1); } RD(v); emu->PC_ = op.PC + 4; return false); break;
+      default:
+        op->handler = BB_OP(emu->PC_ = op.PC + 4; return false);
+        break;
+      }
+    }
+    return true;
+  case Opcode::FENCE:
+    if (func3 == 1) {
+      // RV32I: FENCE.I
+      op->handler = BB_OP(emu->flush_decoded(); emu->blocks_dirty_ = true; emu->PC_ = op.PC + 4; return false);
+      return true;
+    }
+    op->handler = BB_OP(return true);
+    return false;
+  default:
+    std::abort();
+  }
+
+  #undef BB_OP
+  #undef RS1
+  #undef RS2
+  #undef RD
+  #undef SHAMT_MASK
+}
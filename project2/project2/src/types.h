@@ -58,6 +58,8 @@ enum class FUType {
   ALU,
   LSU,
   CSR,
+  MUL,
+  DIV,
 };
 
 inline std::ostream &operator<<(std::ostream &os, const FUType& type) {
@@ -65,6 +67,8 @@ inline std::ostream &operator<<(std::ostream &os, const FUType& type) {
   case FUType::ALU: os << "ALU"; break;
   case FUType::LSU: os << "LSU"; break;
   case FUType::CSR: os << "CSR"; break;
+  case FUType::MUL: os << "MUL"; break;
+  case FUType::DIV: os << "DIV"; break;
   default: assert(false);
   }
   return os;
@@ -141,6 +145,32 @@ struct mem_addr_size_t {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+struct MemReq {
+  uint64_t addr;
+  bool     write;
+  uint32_t tag;
+  uint64_t uuid;
+  Word     PC;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const MemReq& req) {
+  os << (req.write ? "wr" : "rd") << " addr=0x" << std::hex << req.addr;
+  os << ", tag=" << std::dec << req.tag << " (#" << req.uuid << ")";
+  return os;
+}
+
+struct MemRsp {
+  uint32_t tag;
+  uint64_t uuid;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const MemRsp& rsp) {
+  os << "tag=" << std::dec << rsp.tag << " (#" << rsp.uuid << ")";
+  return os;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 enum class CSROp {
   CSRRW,
   CSRRS,